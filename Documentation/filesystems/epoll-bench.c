@@ -0,0 +1,229 @@
+/*
+ * epoll-bench.c - epoll throughput with many watched descriptors
+ *
+ * A number of pipes are added to one epoll instance, in level-triggered
+ * EPOLLIN mode, and one of three loads is run against it:
+ *
+ *   wait    every pipe has data that is never read, so each
+ *           epoll_wait() finds all of them ready and returns up to
+ *           maxevents events: how fast ready events are copied out.
+ *   wakeup  a second thread writes a byte to one pipe after the other;
+ *           the main thread sleeps in epoll_wait(), reads the byte and
+ *           acknowledges it: how many wakeups per second get through.
+ *   ctl     every pipe is removed, added back and modified with
+ *           epoll_ctl(): the cost of each operation with a large set.
+ *
+ * Build: gcc -O2 -Wall -o epoll-bench epoll-bench.c -lpthread
+ * Usage: epoll-bench [-n fds] [-l loops] [-m maxevents] wait|wakeup|ctl
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+static int nr_pipes = 512;
+static int loops = 10000;
+static int maxevents = 256;
+
+static int epfd;
+static int (*pipes)[2];
+static int ack[2];
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void report(const char *what, long long ops, double sec)
+{
+	printf("%-8s %lld in %.2f s: %.2f usecs each, %.0f/s\n", what, ops,
+	       sec, sec * 1e6 / ops, ops / sec);
+}
+
+/* Each pipe costs two fds */
+static void setup_pipes(int fill)
+{
+	struct epoll_event ev;
+	struct rlimit rl;
+	int i;
+
+	if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	pipes = calloc(nr_pipes, sizeof(*pipes));
+	if (!pipes)
+		die("calloc");
+	epfd = epoll_create(nr_pipes);
+	if (epfd < 0)
+		die("epoll_create");
+
+	for (i = 0; i < nr_pipes; i++) {
+		if (pipe(pipes[i]))
+			die("pipe");
+		if (fill && write(pipes[i][1], "", 1) != 1)
+			die("write");
+
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, pipes[i][0], &ev))
+			die("epoll_ctl");
+	}
+}
+
+static void run_wait(struct epoll_event *events)
+{
+	long long nr_events = 0;
+	double start, sec;
+	int i, ret;
+
+	setup_pipes(1);
+	start = now_sec();
+	for (i = 0; i < loops; i++) {
+		ret = epoll_wait(epfd, events, maxevents, 0);
+		if (ret < 0)
+			die("epoll_wait");
+		nr_events += ret;
+	}
+	sec = now_sec() - start;
+	report("wait", loops, sec);
+	report("events", nr_events, sec);
+}
+
+static void *writer(void *arg)
+{
+	char c;
+	int i;
+
+	for (i = 0; i < loops; i++) {
+		if (write(pipes[i % nr_pipes][1], "", 1) != 1)
+			die("write");
+		if (read(ack[0], &c, 1) != 1)
+			die("read ack");
+	}
+	return NULL;
+}
+
+static void run_wakeup(struct epoll_event *events)
+{
+	pthread_t thread;
+	double start;
+	int i, ret;
+	char c;
+
+	setup_pipes(0);
+	if (pipe(ack))
+		die("pipe");
+
+	start = now_sec();
+	if (pthread_create(&thread, NULL, writer, NULL))
+		die("pthread_create");
+	for (i = 0; i < loops; i++) {
+		ret = epoll_wait(epfd, events, maxevents, -1);
+		if (ret < 0)
+			die("epoll_wait");
+		if (ret != 1)
+			die("unexpected events");
+		if (read(pipes[events[0].data.u32][0], &c, 1) != 1)
+			die("read");
+		if (write(ack[1], "", 1) != 1)
+			die("write ack");
+	}
+	pthread_join(thread, NULL);
+	report("wakeup", loops, now_sec() - start);
+}
+
+static void run_ctl(void)
+{
+	static const char * const names[] = { "del", "add", "mod" };
+	static const int ops[] = { EPOLL_CTL_DEL, EPOLL_CTL_ADD,
+				   EPOLL_CTL_MOD };
+	double elapsed[3] = { 0, 0, 0 }, start;
+	struct epoll_event ev;
+	int i, j, op, fd, rounds;
+
+	setup_pipes(0);
+	rounds = (loops + nr_pipes - 1) / nr_pipes;
+	for (j = 0; j < rounds; j++) {
+		for (op = 0; op < 3; op++) {
+			start = now_sec();
+			for (i = 0; i < nr_pipes; i++) {
+				ev.events = EPOLLIN;
+				if (ops[op] == EPOLL_CTL_MOD && (j & 1))
+					ev.events |= EPOLLOUT;
+				ev.data.u32 = i;
+				fd = pipes[i][0];
+				if (epoll_ctl(epfd, ops[op], fd, &ev))
+					die(names[op]);
+			}
+			elapsed[op] += now_sec() - start;
+		}
+	}
+	for (op = 0; op < 3; op++)
+		report(names[op], (long long)rounds * nr_pipes,
+		       elapsed[op]);
+}
+
+int main(int argc, char **argv)
+{
+	struct epoll_event *events;
+	const char *mode;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:l:m:")) != -1) {
+		switch (opt) {
+		case 'n':
+			nr_pipes = atoi(optarg);
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		case 'm':
+			maxevents = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || nr_pipes <= 0 || loops <= 0 ||
+	    maxevents <= 0)
+		goto usage;
+	mode = argv[optind];
+	if (strcmp(mode, "wait") && strcmp(mode, "wakeup") &&
+	    strcmp(mode, "ctl"))
+		goto usage;
+
+	events = calloc(maxevents, sizeof(*events));
+	if (!events)
+		die("calloc");
+
+	printf("# %d pipes, %d loops, maxevents %d\n", nr_pipes, loops,
+	       maxevents);
+	if (!strcmp(mode, "wait"))
+		run_wait(events);
+	else if (!strcmp(mode, "wakeup"))
+		run_wakeup(events);
+	else
+		run_ctl();
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-n fds] [-l loops] [-m maxevents] "
+		"wait|wakeup|ctl\n", argv[0]);
+	return 1;
+}
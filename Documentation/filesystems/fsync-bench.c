@@ -0,0 +1,178 @@
+/*
+ * fsync-bench.c - fsync() load in the style of an SQLite database
+ *
+ * Each thread runs small transactions against its own database file the
+ * way SQLite does in its default rollback journal mode:
+ *
+ *   write the original pages to a fresh "-journal" file, fsync() it,
+ *   overwrite the pages in the database file, fsync() it,
+ *   truncate the journal.
+ *
+ * The database pages are rewritten in place, so once the file has been
+ * filled no blocks are allocated for it.  Compare ext4 mounted with
+ * fsync=strict and fsync=data, and look at the fsync: lines of
+ * /proc/fs/jbd2/<dev>/info, to see the effect of commit batching.
+ *
+ * Build: gcc -O2 -Wall -o fsync-bench fsync-bench.c -lpthread
+ * Usage: fsync-bench [-t threads] [-n transactions] [-p pages] <dir>
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PAGE_SZ		4096
+#define DB_PAGES	256
+#define NR_BUCKETS	16	/* log2 histogram, bucket 0 is < 1ms */
+
+static const char *dir;
+static int nr_txns = 1000;
+static int pages_per_txn = 2;
+
+struct worker {
+	pthread_t thread;
+	int id;
+	unsigned long lat[NR_BUCKETS];
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	char db_name[4096], jrnl_name[4096];
+	char page[PAGE_SZ];
+	unsigned int seed = w->id;
+	int db, jrnl, i, j;
+
+	snprintf(db_name, sizeof(db_name), "%s/bench-%d.db", dir, w->id);
+	snprintf(jrnl_name, sizeof(jrnl_name), "%s/bench-%d.db-journal",
+		 dir, w->id);
+
+	db = open(db_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (db < 0)
+		die(db_name);
+	memset(page, 0, sizeof(page));
+	for (i = 0; i < DB_PAGES; i++)
+		if (pwrite(db, page, PAGE_SZ, (off_t)i * PAGE_SZ) != PAGE_SZ)
+			die("pwrite");
+	if (fsync(db))
+		die("fsync");
+
+	for (i = 0; i < nr_txns; i++) {
+		double start = now_ms(), ms;
+		int bucket = 0;
+
+		jrnl = open(jrnl_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (jrnl < 0)
+			die(jrnl_name);
+		for (j = 0; j < pages_per_txn; j++) {
+			off_t off = (off_t)(rand_r(&seed) % DB_PAGES);
+
+			off *= PAGE_SZ;
+
+			if (pread(db, page, PAGE_SZ, off) != PAGE_SZ ||
+			    write(jrnl, page, PAGE_SZ) != PAGE_SZ)
+				die("journal");
+			page[i % PAGE_SZ]++;
+			if (pwrite(db, page, PAGE_SZ, off) != PAGE_SZ)
+				die("pwrite");
+		}
+		if (fsync(jrnl) || fsync(db))
+			die("fsync");
+		if (ftruncate(jrnl, 0) || close(jrnl))
+			die("ftruncate");
+
+		ms = now_ms() - start;
+		while (bucket < NR_BUCKETS - 1 && ms >= (1 << bucket))
+			bucket++;
+		w->lat[bucket]++;
+	}
+
+	close(db);
+	unlink(jrnl_name);
+	unlink(db_name);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long lat[NR_BUCKETS] = { 0 };
+	int nr_threads = 4, opt, i, b;
+	struct worker *workers;
+	double start, elapsed;
+
+	while ((opt = getopt(argc, argv, "t:n:p:")) != -1) {
+		switch (opt) {
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'n':
+			nr_txns = atoi(optarg);
+			break;
+		case 'p':
+			pages_per_txn = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || nr_threads < 1 || nr_txns < 1 ||
+	    pages_per_txn < 1)
+		goto usage;
+	dir = argv[optind];
+
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		die("calloc");
+
+	start = now_ms();
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].id = i;
+		errno = pthread_create(&workers[i].thread, NULL, worker_fn,
+				       &workers[i]);
+		if (errno)
+			die("pthread_create");
+	}
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(workers[i].thread, NULL);
+	elapsed = now_ms() - start;
+
+	printf("%d threads, %d transactions each: %.0f transactions/s, "
+	       "%.0f fsyncs/s\n", nr_threads, nr_txns,
+	       nr_threads * nr_txns * 1000.0 / elapsed,
+	       2 * nr_threads * nr_txns * 1000.0 / elapsed);
+
+	for (i = 0; i < nr_threads; i++)
+		for (b = 0; b < NR_BUCKETS; b++)
+			lat[b] += workers[i].lat[b];
+	printf("transaction latency:\n");
+	for (b = 0; b < NR_BUCKETS; b++)
+		if (lat[b])
+			printf("  %s%6d ms: %lu\n", b == NR_BUCKETS - 1 ?
+			       ">=" : " <", b == NR_BUCKETS - 1 ?
+			       1 << (b - 1) : 1 << b, lat[b]);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-t threads] [-n transactions] "
+		"[-p pages] <dir>\n", argv[0]);
+	return 1;
+}
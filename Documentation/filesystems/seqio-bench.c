@@ -0,0 +1,116 @@
+/*
+ * seqio-bench.c - sequential read and write throughput
+ *
+ * Writes a file sequentially in fixed size chunks, fsync()s it, drops
+ * it from the page cache and reads it back, reporting the throughput
+ * of each pass.  This is the dd-like streaming load that benefits from
+ * the MMC block driver preparing the next request while the current
+ * one is on the bus; compare a kernel with and without that to see it.
+ *
+ * With -r the file (or block device) is only read, which is safe to
+ * run on a device holding data.  With -d the I/O bypasses the page
+ * cache (O_DIRECT), so each chunk becomes one request of that size.
+ *
+ * Build: gcc -O2 -Wall -o seqio-bench seqio-bench.c
+ * Usage: seqio-bench [-b chunk_kb] [-s size_mb] [-d] [-r] <file>
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static void report(const char *what, long long bytes, double sec)
+{
+	printf("%-6s %lld MB in %.2f s: %.1f MB/s\n", what, bytes >> 20,
+	       sec, bytes / sec / (1 << 20));
+}
+
+int main(int argc, char **argv)
+{
+	long long size = 64LL << 20, done;
+	size_t chunk = 128 << 10;
+	int direct = 0, read_only = 0, flags, fd, opt;
+	double start;
+	ssize_t ret;
+	char *buf;
+
+	while ((opt = getopt(argc, argv, "b:s:dr")) != -1) {
+		switch (opt) {
+		case 'b':
+			chunk = (size_t)atoi(optarg) << 10;
+			break;
+		case 's':
+			size = (long long)atoi(optarg) << 20;
+			break;
+		case 'd':
+			direct = 1;
+			break;
+		case 'r':
+			read_only = 1;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || !chunk || size < (long long)chunk)
+		goto usage;
+
+	if (posix_memalign((void **)&buf, 4096, chunk))
+		die("posix_memalign");
+	memset(buf, 0x5a, chunk);
+	flags = direct ? O_DIRECT : 0;
+
+	if (!read_only) {
+		fd = open(argv[optind], O_WRONLY | O_CREAT | O_TRUNC | flags,
+			  0644);
+		if (fd < 0)
+			die(argv[optind]);
+		start = now_sec();
+		for (done = 0; done < size; done += chunk)
+			if (write(fd, buf, chunk) != (ssize_t)chunk)
+				die("write");
+		if (fsync(fd))
+			die("fsync");
+		report("write", done, now_sec() - start);
+		close(fd);
+	}
+
+	fd = open(argv[optind], O_RDONLY | flags);
+	if (fd < 0)
+		die(argv[optind]);
+	/* make the read pass come from the device */
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	start = now_sec();
+	for (done = 0; done < size; done += ret) {
+		ret = read(fd, buf, chunk);
+		if (ret < 0)
+			die("read");
+		if (!ret)
+			break;
+	}
+	report("read", done, now_sec() - start);
+	close(fd);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-b chunk_kb] [-s size_mb] [-d] [-r] "
+		"<file>\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,139 @@
+/*
+ * Per-queue request latency histograms
+ *
+ * Every request accounted in blk_account_io_done() adds one sample to
+ * two log2 histograms: the time it waited in the queue before the
+ * driver took it (wait), and the time the driver took to complete it
+ * (service).  Reads, sync writes and async writes are kept apart.  The
+ * counters are per-cpu, so the completion path takes no lock.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/percpu.h>
+#include <linux/math64.h>
+
+#include "blk.h"
+
+/*
+ * Bucket 0 counts requests that took less than 64us, bucket i the ones
+ * below 64us << i, and the last bucket everything from about 1s up.
+ */
+#define BLK_LAT_SHIFT		6
+#define BLK_LAT_BUCKETS		16
+
+enum {
+	BLK_LAT_READ,
+	BLK_LAT_SYNC_WRITE,
+	BLK_LAT_ASYNC_WRITE,
+	BLK_LAT_NR_TYPES,
+};
+
+static const char *blk_lat_names[BLK_LAT_NR_TYPES] = {
+	[BLK_LAT_READ]		= "read",
+	[BLK_LAT_SYNC_WRITE]	= "sync_write",
+	[BLK_LAT_ASYNC_WRITE]	= "async_write",
+};
+
+struct blk_latency_stats {
+	unsigned long wait[BLK_LAT_NR_TYPES][BLK_LAT_BUCKETS];
+	unsigned long service[BLK_LAT_NR_TYPES][BLK_LAT_BUCKETS];
+};
+
+int blk_latency_init(struct request_queue *q)
+{
+	q->latency_stats = alloc_percpu(struct blk_latency_stats);
+	if (!q->latency_stats)
+		return -ENOMEM;
+
+	return 0;
+}
+
+void blk_latency_exit(struct request_queue *q)
+{
+	free_percpu(q->latency_stats);
+}
+
+static int blk_latency_bucket(u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+
+	return min(fls64(us >> BLK_LAT_SHIFT), BLK_LAT_BUCKETS - 1);
+}
+
+static int blk_latency_type(struct request *rq)
+{
+	if (rq_data_dir(rq) == READ)
+		return BLK_LAT_READ;
+	if (rq_is_sync(rq))
+		return BLK_LAT_SYNC_WRITE;
+	return BLK_LAT_ASYNC_WRITE;
+}
+
+/*
+ * Called from blk_account_io_done() with the queue lock held, @cpu is
+ * the one returned by part_stat_lock().
+ */
+void blk_account_latency(struct request *rq, int cpu)
+{
+	struct blk_latency_stats *stats;
+	u64 start = rq_start_time_ns(rq);
+	u64 io_start = rq_io_start_time_ns(rq);
+	u64 now = sched_clock();
+	int type;
+
+	/* requests the driver never dequeued have no dispatch time */
+	if (!io_start || !time_after64(now, io_start))
+		return;
+
+	stats = per_cpu_ptr(rq->q->latency_stats, cpu);
+	type = blk_latency_type(rq);
+
+	stats->service[type][blk_latency_bucket(now - io_start)]++;
+	if (time_after64(io_start, start))
+		stats->wait[type][blk_latency_bucket(io_start - start)]++;
+}
+
+static ssize_t blk_latency_show(struct request_queue *q, char *page,
+				size_t offset)
+{
+	unsigned long sum[BLK_LAT_BUCKETS];
+	ssize_t len = 0;
+	int cpu, type, i;
+
+	len += sprintf(page + len, "%-11s", "usecs");
+	for (i = 0; i < BLK_LAT_BUCKETS - 1; i++)
+		len += sprintf(page + len, " <%u", 1U << (BLK_LAT_SHIFT + i));
+	len += sprintf(page + len, " >=%u\n", 1U << (BLK_LAT_SHIFT + i - 1));
+
+	for (type = 0; type < BLK_LAT_NR_TYPES; type++) {
+		memset(sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu) {
+			struct blk_latency_stats *stats =
+				per_cpu_ptr(q->latency_stats, cpu);
+			unsigned long *hist = (void *)stats + offset;
+
+			for (i = 0; i < BLK_LAT_BUCKETS; i++)
+				sum[i] += hist[type * BLK_LAT_BUCKETS + i];
+		}
+
+		len += sprintf(page + len, "%-11s", blk_lat_names[type]);
+		for (i = 0; i < BLK_LAT_BUCKETS; i++)
+			len += sprintf(page + len, " %lu", sum[i]);
+		len += sprintf(page + len, "\n");
+	}
+
+	return len;
+}
+
+ssize_t queue_wait_latency_show(struct request_queue *q, char *page)
+{
+	return blk_latency_show(q, page,
+				offsetof(struct blk_latency_stats, wait));
+}
+
+ssize_t queue_service_latency_show(struct request_queue *q, char *page)
+{
+	return blk_latency_show(q, page,
+				offsetof(struct blk_latency_stats, service));
+}
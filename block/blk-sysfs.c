@@ -374,6 +374,18 @@ static struct queue_sysfs_entry queue_iostats_entry = {
 	.store = queue_iostats_store,
 };
 
+#ifdef CONFIG_BLK_DEV_LATENCY
+static struct queue_sysfs_entry queue_wait_latency_entry = {
+	.attr = {.name = "wait_latency", .mode = S_IRUGO },
+	.show = queue_wait_latency_show,
+};
+
+static struct queue_sysfs_entry queue_service_latency_entry = {
+	.attr = {.name = "service_latency", .mode = S_IRUGO },
+	.show = queue_service_latency_show,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -394,6 +406,10 @@ static struct attribute *default_attrs[] = {
 	&queue_nomerges_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
+#ifdef CONFIG_BLK_DEV_LATENCY
+	&queue_wait_latency_entry.attr,
+	&queue_service_latency_entry.attr,
+#endif
 	NULL,
 };
 
@@ -471,6 +487,7 @@ static void blk_release_queue(struct kobject *kobj)
 		__blk_queue_free_tags(q);
 
 	blk_trace_shutdown(q);
+	blk_latency_exit(q);
 
 	bdi_destroy(&q->backing_dev_info);
 	kmem_cache_free(blk_requestq_cachep, q);
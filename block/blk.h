@@ -95,6 +95,21 @@ static inline int blk_should_fake_timeout(struct request_queue *q)
 }
 #endif
 
+#ifdef CONFIG_BLK_DEV_LATENCY
+int blk_latency_init(struct request_queue *q);
+void blk_latency_exit(struct request_queue *q);
+void blk_account_latency(struct request *rq, int cpu);
+ssize_t queue_wait_latency_show(struct request_queue *q, char *page);
+ssize_t queue_service_latency_show(struct request_queue *q, char *page);
+#else
+static inline int blk_latency_init(struct request_queue *q)
+{
+	return 0;
+}
+static inline void blk_latency_exit(struct request_queue *q) {}
+static inline void blk_account_latency(struct request *rq, int cpu) {}
+#endif
+
 struct io_context *current_io_context(gfp_t gfp_flags, int node);
 
 int ll_back_merge_fn(struct request_queue *q, struct request *req,
@@ -0,0 +1,495 @@
+/*
+ *  ROW (READ Over WRITE) i/o scheduler.
+ *
+ *  Flash storage has no seek penalty, and a read that a task waits on
+ *  in a page fault matters far more than the writeback behind it.
+ *  Requests are kept in three classes served in strict priority order:
+ *  sync reads, sync writes, async writes.  Each class is dispatched in
+ *  batches of up to its quantum; the lower classes are protected from
+ *  starvation by a batch count and an expire time.  The queue never
+ *  idles waiting for more requests from a process.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
+
+/*
+ * See Documentation/block/row-iosched.txt
+ */
+enum row_class {
+	ROW_SYNC_READ,
+	ROW_SYNC_WRITE,
+	ROW_ASYNC_WRITE,
+	ROW_NR_CLASSES,
+};
+
+/* # of requests dispatched from a class in one batch */
+static const int row_quantum[ROW_NR_CLASSES] = { 16, 8, 4 };
+/* max # of batches of higher classes a class waits for */
+static const int row_starve_limit[ROW_NR_CLASSES] = { 0, 4, 8 };
+/* max time a request of a class waits, these limits are SOFT! */
+static const int row_expire[ROW_NR_CLASSES] = { 0, HZ / 4, HZ };
+
+/* latency histogram buckets: < 1ms, then powers of two up to >= 1024ms */
+#define ROW_LAT_BUCKETS	12
+
+struct row_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are on the fifo list and on the sort list of their
+	 * class, the latter for front merges
+	 */
+	struct list_head fifo_list[ROW_NR_CLASSES];
+	struct rb_root sort_list[ROW_NR_CLASSES];
+
+	int cur_class;			/* class of the current batch */
+	int batched;			/* requests dispatched in it */
+	int starving;			/* batch served a starved class */
+	int starved[ROW_NR_CLASSES];	/* batches a class waited for */
+
+	/* insertion to completion latency */
+	unsigned long lat_hist[ROW_NR_CLASSES][ROW_LAT_BUCKETS];
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int quantum[ROW_NR_CLASSES];
+	int starve_limit[ROW_NR_CLASSES];
+	int expire[ROW_NR_CLASSES];
+};
+
+static inline int row_bio_class(struct bio *bio)
+{
+	if (bio_data_dir(bio) == READ)
+		return ROW_SYNC_READ;
+	if (bio_rw_flagged(bio, BIO_RW_SYNCIO))
+		return ROW_SYNC_WRITE;
+	return ROW_ASYNC_WRITE;
+}
+
+static inline int row_rq_class(struct request *rq)
+{
+	if (rq_data_dir(rq) == READ)
+		return ROW_SYNC_READ;
+	if (rq_is_sync(rq))
+		return ROW_SYNC_WRITE;
+	return ROW_ASYNC_WRITE;
+}
+
+static inline unsigned long row_now_us(void)
+{
+	return (unsigned long)ktime_to_us(ktime_get());
+}
+
+static void row_move_to_dispatch(struct row_data *, struct request *);
+
+static void
+row_add_rq_rb(struct row_data *rd, struct request *rq)
+{
+	struct rb_root *root = &rd->sort_list[row_rq_class(rq)];
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		row_move_to_dispatch(rd, __alias);
+}
+
+/*
+ * add rq to rbtree and to the fifo of its class
+ */
+static void
+row_add_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	const int class = row_rq_class(rq);
+
+	row_add_rq_rb(rd, rq);
+
+	rq->elevator_private = (void *)(long)class;
+	rq->elevator_private2 = (void *)row_now_us();
+
+	rq_set_fifo_time(rq, jiffies + rd->expire[class]);
+	list_add_tail(&rq->queuelist, &rd->fifo_list[class]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void row_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	elv_rb_del(&rd->sort_list[row_rq_class(rq)], rq);
+}
+
+static int
+row_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	sector_t sector = bio->bi_sector + bio_sectors(bio);
+	struct request *__rq;
+
+	/*
+	 * back merges are found by the elevator core, check for a
+	 * front merge
+	 */
+	__rq = elv_rb_find(&rd->sort_list[row_bio_class(bio)], sector);
+	if (__rq) {
+		BUG_ON(sector != blk_rq_pos(__rq));
+
+		if (elv_rq_merge_ok(__rq, bio)) {
+			*req = __rq;
+			return ELEVATOR_FRONT_MERGE;
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void row_merged_request(struct request_queue *q,
+			       struct request *req, int type)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(&rd->sort_list[row_rq_class(req)], req);
+		row_add_rq_rb(rd, req);
+	}
+}
+
+static void
+row_merged_requests(struct request_queue *q, struct request *req,
+		    struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    req->elevator_private == next->elevator_private) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	row_remove_request(q, next);
+}
+
+/*
+ * only merge within a class: a sync bio must not end up waiting in an
+ * async request, nor an async one be served at sync priority
+ */
+static int row_allow_merge(struct request_queue *q, struct request *rq,
+			   struct bio *bio)
+{
+	return row_bio_class(bio) == row_rq_class(rq);
+}
+
+/*
+ * move request from sort list to dispatch queue.
+ */
+static void
+row_move_to_dispatch(struct row_data *rd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	row_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * returns 1 if the oldest request of a class waited longer than its
+ * expire time.  Requires !list_empty(&rd->fifo_list[class])
+ */
+static inline int row_fifo_expired(struct row_data *rd, int class)
+{
+	struct request *rq = rq_entry_fifo(rd->fifo_list[class].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * Pick the class to dispatch from: carry on with the current batch
+ * unless it is used up or a higher class has requests, and otherwise
+ * start a batch of the highest class with requests, or of a starved
+ * lower class.
+ */
+static int row_choose_class(struct row_data *rd)
+{
+	int class, highest, i;
+
+	for (highest = 0; highest < ROW_NR_CLASSES; highest++)
+		if (!list_empty(&rd->fifo_list[highest]))
+			break;
+	if (highest == ROW_NR_CLASSES)
+		return -1;
+
+	class = rd->cur_class;
+	if (!list_empty(&rd->fifo_list[class]) &&
+	    rd->batched < rd->quantum[class] &&
+	    (rd->starving || class == highest))
+		goto out;
+
+	for (class = highest + 1; class < ROW_NR_CLASSES; class++) {
+		if (list_empty(&rd->fifo_list[class]))
+			continue;
+		if (rd->starved[class] >= rd->starve_limit[class] ||
+		    row_fifo_expired(rd, class))
+			break;
+	}
+	if (class == ROW_NR_CLASSES)
+		class = highest;
+	rd->starving = class != highest;
+
+	/* the classes below the chosen one wait for another batch */
+	for (i = 0; i < ROW_NR_CLASSES; i++) {
+		if (i == class)
+			rd->starved[i] = 0;
+		else if (i > class && !list_empty(&rd->fifo_list[i]))
+			rd->starved[i]++;
+	}
+
+	rd->cur_class = class;
+	rd->batched = 0;
+out:
+	rd->batched++;
+	return class;
+}
+
+/*
+ * dispatch the oldest request of the chosen class.  There is no seek
+ * cost to optimise for, and nothing to wait for: when force is set we
+ * are called until the scheduler is empty, which this does anyway.
+ */
+static int row_dispatch_requests(struct request_queue *q, int force)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	int class;
+
+	class = row_choose_class(rd);
+	if (class < 0)
+		return 0;
+
+	row_move_to_dispatch(rd, rq_entry_fifo(rd->fifo_list[class].next));
+	return 1;
+}
+
+static void row_completed_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	const int class = (long)rq->elevator_private;
+	unsigned long lat_ms;
+	int bucket;
+
+	lat_ms = (row_now_us() - (unsigned long)rq->elevator_private2) / 1000;
+	bucket = min_t(int, fls_long(lat_ms), ROW_LAT_BUCKETS - 1);
+	rd->lat_hist[class][bucket]++;
+}
+
+static int row_queue_empty(struct request_queue *q)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	int class;
+
+	for (class = 0; class < ROW_NR_CLASSES; class++)
+		if (!list_empty(&rd->fifo_list[class]))
+			return 0;
+
+	return 1;
+}
+
+static void row_exit_queue(struct elevator_queue *e)
+{
+	struct row_data *rd = e->elevator_data;
+	int class;
+
+	for (class = 0; class < ROW_NR_CLASSES; class++)
+		BUG_ON(!list_empty(&rd->fifo_list[class]));
+
+	kfree(rd);
+}
+
+/*
+ * initialize elevator private data (row_data).
+ */
+static void *row_init_queue(struct request_queue *q)
+{
+	struct row_data *rd;
+	int class;
+
+	rd = kmalloc_node(sizeof(*rd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!rd)
+		return NULL;
+
+	for (class = 0; class < ROW_NR_CLASSES; class++) {
+		INIT_LIST_HEAD(&rd->fifo_list[class]);
+		rd->quantum[class] = row_quantum[class];
+		rd->starve_limit[class] = row_starve_limit[class];
+		rd->expire[class] = row_expire[class];
+		rd->sort_list[class] = RB_ROOT;
+	}
+	return rd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+row_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+row_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return row_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(row_read_quantum_show, rd->quantum[ROW_SYNC_READ], 0);
+SHOW_FUNCTION(row_sync_write_quantum_show, rd->quantum[ROW_SYNC_WRITE], 0);
+SHOW_FUNCTION(row_async_write_quantum_show, rd->quantum[ROW_ASYNC_WRITE], 0);
+SHOW_FUNCTION(row_sync_write_starved_show, rd->starve_limit[ROW_SYNC_WRITE], 0);
+SHOW_FUNCTION(row_async_write_starved_show, rd->starve_limit[ROW_ASYNC_WRITE], 0);
+SHOW_FUNCTION(row_sync_write_expire_show, rd->expire[ROW_SYNC_WRITE], 1);
+SHOW_FUNCTION(row_async_write_expire_show, rd->expire[ROW_ASYNC_WRITE], 1);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data;							\
+	int ret = row_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(row_read_quantum_store, &rd->quantum[ROW_SYNC_READ], 1, INT_MAX, 0);
+STORE_FUNCTION(row_sync_write_quantum_store, &rd->quantum[ROW_SYNC_WRITE], 1, INT_MAX, 0);
+STORE_FUNCTION(row_async_write_quantum_store, &rd->quantum[ROW_ASYNC_WRITE], 1, INT_MAX, 0);
+STORE_FUNCTION(row_sync_write_starved_store, &rd->starve_limit[ROW_SYNC_WRITE], 0, INT_MAX, 0);
+STORE_FUNCTION(row_async_write_starved_store, &rd->starve_limit[ROW_ASYNC_WRITE], 0, INT_MAX, 0);
+STORE_FUNCTION(row_sync_write_expire_store, &rd->expire[ROW_SYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(row_async_write_expire_store, &rd->expire[ROW_ASYNC_WRITE], 0, INT_MAX, 1);
+#undef STORE_FUNCTION
+
+static ssize_t row_lat_show(struct row_data *rd, int class, char *page)
+{
+	unsigned long *hist = rd->lat_hist[class];
+	ssize_t len = 0;
+	int i;
+
+	len += sprintf(page + len, "<1ms %lu\n", hist[0]);
+	for (i = 1; i < ROW_LAT_BUCKETS - 1; i++)
+		len += sprintf(page + len, "<%ums %lu\n", 1U << i, hist[i]);
+	len += sprintf(page + len, ">=%ums %lu\n", 1U << (i - 1), hist[i]);
+
+	return len;
+}
+
+#define LAT_SHOW_FUNCTION(__FUNC, __CLASS)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	return row_lat_show(e->elevator_data, __CLASS, page);		\
+}
+LAT_SHOW_FUNCTION(row_read_lat_show, ROW_SYNC_READ);
+LAT_SHOW_FUNCTION(row_sync_write_lat_show, ROW_SYNC_WRITE);
+LAT_SHOW_FUNCTION(row_async_write_lat_show, ROW_ASYNC_WRITE);
+#undef LAT_SHOW_FUNCTION
+
+#define ROW_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
+				      row_##name##_store)
+#define ROW_ATTR_RO(name) \
+	__ATTR(name, S_IRUGO, row_##name##_show, NULL)
+
+static struct elv_fs_entry row_attrs[] = {
+	ROW_ATTR(read_quantum),
+	ROW_ATTR(sync_write_quantum),
+	ROW_ATTR(async_write_quantum),
+	ROW_ATTR(sync_write_starved),
+	ROW_ATTR(async_write_starved),
+	ROW_ATTR(sync_write_expire),
+	ROW_ATTR(async_write_expire),
+	ROW_ATTR_RO(read_lat),
+	ROW_ATTR_RO(sync_write_lat),
+	ROW_ATTR_RO(async_write_lat),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_row = {
+	.ops = {
+		.elevator_merge_fn = 		row_merge,
+		.elevator_merged_fn =		row_merged_request,
+		.elevator_merge_req_fn =	row_merged_requests,
+		.elevator_allow_merge_fn =	row_allow_merge,
+		.elevator_dispatch_fn =		row_dispatch_requests,
+		.elevator_add_req_fn =		row_add_request,
+		.elevator_completed_req_fn =	row_completed_request,
+		.elevator_queue_empty_fn =	row_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		row_init_queue,
+		.elevator_exit_fn =		row_exit_queue,
+	},
+
+	.elevator_attrs = row_attrs,
+	.elevator_name = "row",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init row_init(void)
+{
+	elv_register(&iosched_row);
+
+	return 0;
+}
+
+static void __exit row_exit(void)
+{
+	elv_unregister(&iosched_row);
+}
+
+module_init(row_init);
+module_exit(row_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("ROW (READ Over WRITE) IO scheduler");
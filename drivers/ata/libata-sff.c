@@ -3324,7 +3324,7 @@ int __init ata_sff_init(void)
 	 * another.  It's an ugly wart that users DO occasionally complain
 	 * about; luckily most users have at most one PIO polled device.
 	 */
-	ata_sff_wq = create_workqueue("ata_sff");
+	ata_sff_wq = alloc_workqueue("ata_sff", WQ_RESCUER, 1);
 	if (!ata_sff_wq)
 		return -ENOMEM;
 
@@ -33,6 +33,7 @@ struct driver_private {
 	struct klist_node knode_bus;
 	struct module_kobject *mkobj;
 	struct device_driver *driver;
+	struct list_head probe_running;	/* default async probe domain */
 };
 #define to_driver(obj) container_of(obj, struct driver_private, kobj)
 
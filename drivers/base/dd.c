@@ -24,6 +24,10 @@
 #include <linux/wait.h>
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/boot_timeline.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -101,10 +105,130 @@ EXPORT_SYMBOL_GPL(device_bind_driver);
 static atomic_t probe_count = ATOMIC_INIT(0);
 static DECLARE_WAIT_QUEUE_HEAD(probe_waitqueue);
 
+/*
+ * With initcall_debug, the time spent probing is accounted per driver
+ * during boot and reported once all probes are done, together with
+ * the probe domain which finished last: the critical path boot time
+ * was waiting for.  Synchronous probes form one domain of their own.
+ */
+struct probe_stat {
+	struct list_head	node;
+	char			name[48];	/* bus/driver */
+	struct list_head	*domain;	/* NULL if synchronous */
+	unsigned int		nr_probed;
+	s64			busy_us;	/* time spent in probe */
+	s64			start_us;	/* first probe started */
+	s64			end_us;		/* last probe finished */
+};
+
+static LIST_HEAD(probe_stats);
+static DEFINE_MUTEX(probe_stats_mutex);
+static bool probe_stats_reported;
+
+/* called with probe_stats_mutex held */
+static struct probe_stat *probe_stat_get(struct device_driver *drv)
+{
+	struct probe_stat *stat;
+	char name[sizeof(stat->name)];
+
+	if (probe_stats_reported)
+		return NULL;
+
+	snprintf(name, sizeof(name), "%s/%s", drv->bus->name, drv->name);
+	list_for_each_entry(stat, &probe_stats, node)
+		if (!strcmp(stat->name, name))
+			return stat;
+
+	stat = kzalloc(sizeof(*stat), GFP_KERNEL);
+	if (stat) {
+		strcpy(stat->name, name);
+		list_add_tail(&stat->node, &probe_stats);
+	}
+	return stat;
+}
+
+static void probe_stat_add(struct device_driver *drv, struct device *dev,
+			   ktime_t calltime, ktime_t rettime)
+{
+	struct probe_stat *stat;
+	s64 duration = ktime_to_us(ktime_sub(rettime, calltime));
+
+	printk(KERN_DEBUG "probe of %s by %s took %lld usecs\n",
+	       dev_name(dev), drv->name, (long long)duration);
+
+	mutex_lock(&probe_stats_mutex);
+	stat = probe_stat_get(drv);
+	if (stat) {
+		if (!stat->nr_probed++)
+			stat->start_us = ktime_to_us(calltime);
+		stat->busy_us += duration;
+		stat->end_us = ktime_to_us(rettime);
+	}
+	mutex_unlock(&probe_stats_mutex);
+}
+
+static void probe_stat_set_domain(struct device_driver *drv,
+				  struct list_head *domain)
+{
+	struct probe_stat *stat;
+
+	mutex_lock(&probe_stats_mutex);
+	stat = probe_stat_get(drv);
+	if (stat)
+		stat->domain = domain;
+	mutex_unlock(&probe_stats_mutex);
+}
+
+static int __init probe_stat_report(void)
+{
+	struct probe_stat *stat, *last = NULL, *n;
+	s64 busy_us = 0;
+
+	if (!initcall_debug)
+		return 0;
+
+	/* wait for the asynchronous probes */
+	async_synchronize_full();
+
+	mutex_lock(&probe_stats_mutex);
+	printk(KERN_INFO "driver probe times:\n");
+	list_for_each_entry(stat, &probe_stats, node) {
+		printk(KERN_INFO "  %-40s %3u device(s) %8lld usecs%s\n",
+		       stat->name, stat->nr_probed, (long long)stat->busy_us,
+		       stat->domain ? " async" : "");
+		if (stat->nr_probed && (!last || stat->end_us > last->end_us))
+			last = stat;
+	}
+
+	if (last) {
+		list_for_each_entry(stat, &probe_stats, node)
+			if (stat->domain == last->domain)
+				busy_us += stat->busy_us;
+		printk(KERN_INFO "probe critical path: %s domain of %s, "
+		       "done at %lld usecs, %lld usecs spent probing\n",
+		       last->domain ? "async" : "synchronous", last->name,
+		       (long long)last->end_us, (long long)busy_us);
+	}
+
+	list_for_each_entry_safe(stat, n, &probe_stats, node) {
+		list_del(&stat->node);
+		kfree(stat);
+	}
+	probe_stats_reported = true;
+	mutex_unlock(&probe_stats_mutex);
+	return 0;
+}
+late_initcall_sync(probe_stat_report);
+
 static int really_probe(struct device *dev, struct device_driver *drv)
 {
+	ktime_t calltime;
 	int ret = 0;
 
+	if (initcall_debug && system_state == SYSTEM_BOOTING)
+		calltime = ktime_get();
+	boot_timeline_begin(BOOT_TL_PROBE, NULL, dev_name(dev));
+
 	atomic_inc(&probe_count);
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
 		 drv->bus->name, __func__, drv->name, dev_name(dev));
@@ -150,6 +274,9 @@ probe_failed:
 	 */
 	ret = 0;
 done:
+	boot_timeline_end(BOOT_TL_PROBE, NULL, dev_name(dev));
+	if (initcall_debug && system_state == SYSTEM_BOOTING)
+		probe_stat_add(drv, dev, calltime, ktime_get());
 	atomic_dec(&probe_count);
 	wake_up(&probe_waitqueue);
 	return ret;
@@ -287,6 +414,48 @@ static int __driver_attach(struct device *dev, void *data)
 	return 0;
 }
 
+/*
+ * Drivers which set probe_async have their devices probed from an
+ * async thread during boot, so that the delays of unrelated probes
+ * overlap.  Probes within one domain still run in the order their
+ * drivers were registered: each driver is a domain of its own unless
+ * it names a probe_domain shared with the drivers it depends on.
+ *
+ * The parent lock isn't taken for these, it would serialize all the
+ * probes on a bus.  It's only needed for USB, whose drivers must not
+ * ask for asynchronous probing.
+ */
+static struct list_head *driver_probe_domain(struct device_driver *drv)
+{
+	return drv->probe_domain ? drv->probe_domain : &drv->p->probe_running;
+}
+
+static int __driver_attach_async(struct device *dev, void *data)
+{
+	struct device_driver *drv = data;
+
+	if (!driver_match_device(drv, dev))
+		return 0;
+
+	device_lock(dev);
+	if (!dev->driver)
+		driver_probe_device(drv, dev);
+	device_unlock(dev);
+
+	return 0;
+}
+
+static void driver_attach_async(void *data, async_cookie_t cookie)
+{
+	struct device_driver *drv = data;
+
+	/* let the earlier drivers of the domain finish probing */
+	async_synchronize_cookie_domain(cookie, driver_probe_domain(drv));
+
+	bus_for_each_dev(drv->bus, NULL, drv, __driver_attach_async);
+	put_driver(drv);
+}
+
 /**
  * driver_attach - try to bind driver to devices.
  * @drv: driver.
@@ -295,9 +464,20 @@ static int __driver_attach(struct device *dev, void *data)
  * match the driver with each one.  If driver_probe_device()
  * returns 0 and the @dev->driver is set, we've found a
  * compatible pair.
+ *
+ * During boot, drivers which set probe_async are attached to their
+ * devices asynchronously.
  */
 int driver_attach(struct device_driver *drv)
 {
+	if (drv->probe_async && system_state == SYSTEM_BOOTING) {
+		if (initcall_debug)
+			probe_stat_set_domain(drv, driver_probe_domain(drv));
+		async_schedule_domain(driver_attach_async, get_driver(drv),
+				      driver_probe_domain(drv));
+		return 0;
+	}
+
 	return bus_for_each_dev(drv->bus, NULL, drv, __driver_attach);
 }
 EXPORT_SYMBOL_GPL(driver_attach);
@@ -367,6 +547,9 @@ void driver_detach(struct device_driver *drv)
 	struct device_private *dev_prv;
 	struct device *dev;
 
+	if (drv->probe_async)
+		async_synchronize_full_domain(driver_probe_domain(drv));
+
 	for (;;) {
 		spin_lock(&drv->p->klist_devices.k_lock);
 		if (list_empty(&drv->p->klist_devices.k_list)) {
@@ -20,6 +20,7 @@
 #include <linux/highmem.h>
 #include <linux/firmware.h>
 #include <linux/slab.h>
+#include <linux/boot_timeline.h>
 
 #define to_dev(obj) container_of(obj, struct device, kobj)
 
@@ -534,6 +535,8 @@ _request_firmware(const struct firmware **firmware_p, const char *name,
 	if (!firmware_p)
 		return -EINVAL;
 
+	boot_timeline_begin(BOOT_TL_FIRMWARE, NULL, name);
+
 	*firmware_p = firmware = kzalloc(sizeof(*firmware), GFP_KERNEL);
 	if (!firmware) {
 		dev_err(device, "%s: kmalloc(struct firmware) failed\n",
@@ -544,7 +547,8 @@ _request_firmware(const struct firmware **firmware_p, const char *name,
 
 	if (fw_get_builtin_firmware(firmware, name)) {
 		dev_dbg(device, "firmware: using built-in firmware %s\n", name);
-		return 0;
+		retval = 0;
+		goto out;
 	}
 
 	if (uevent)
@@ -585,6 +589,7 @@ error_kfree_fw:
 	kfree(firmware);
 	*firmware_p = NULL;
 out:
+	boot_timeline_end(BOOT_TL_FIRMWARE, NULL, name);
 	return retval;
 }
 
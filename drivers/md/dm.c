@@ -1936,7 +1936,7 @@ static struct mapped_device *alloc_dev(int minor)
 	add_disk(md->disk);
 	format_dev_t(md->name, MKDEV(_major, minor));
 
-	md->wq = create_singlethread_workqueue("kdmflush");
+	md->wq = alloc_workqueue("kdmflush", WQ_SINGLE_CPU | WQ_RESCUER, 1);
 	if (!md->wq)
 		goto bad_thread;
 
@@ -36,6 +36,8 @@ void mmc_set_bus_width(struct mmc_host *host, unsigned int width);
 void mmc_set_bus_width_ddr(struct mmc_host *host, unsigned int width, int ddr);
 u32 mmc_select_voltage(struct mmc_host *host, u32 ocr);
 void mmc_set_timing(struct mmc_host *host, unsigned int timing);
+void mmc_init_erase(struct mmc_card *card);
+int mmc_bkops_busy(struct mmc_card *card);
 
 static inline void mmc_delay(unsigned int ms)
 {
@@ -279,6 +279,29 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					&mmc_dbg_ext_csd_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) && card->ext_csd.bkops) {
+		struct mmc_bkops_stats *stats = &card->bkops_stats;
+		struct dentry *bkops;
+
+		bkops = debugfs_create_dir("bkops", root);
+		if (!bkops)
+			goto err;
+		if (!debugfs_create_u32("checks", S_IRUSR, bkops,
+					&stats->checks))
+			goto err;
+		if (!debugfs_create_u32("started", S_IRUSR, bkops,
+					&stats->started))
+			goto err;
+		if (!debugfs_create_u32("urgent", S_IRUSR, bkops,
+					&stats->urgent))
+			goto err;
+		if (!debugfs_create_u32("hpi", S_IRUSR, bkops, &stats->hpi))
+			goto err;
+		if (!debugfs_create_u32("waited", S_IRUSR, bkops,
+					&stats->waited))
+			goto err;
+	}
+
 	return;
 
 err:
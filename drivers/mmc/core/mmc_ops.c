@@ -387,11 +387,27 @@ int mmc_spi_set_crc(struct mmc_host *host, int use_crc)
 	return err;
 }
 
-int mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value)
+/**
+ *	__mmc_switch - modify EXT_CSD register
+ *	@card: the MMC card associated with the data transfer
+ *	@set: cmd set values
+ *	@index: EXT_CSD register index
+ *	@value: value to program into EXT_CSD register
+ *	@timeout_ms: timeout (ms) for operation performed by register write,
+ *                   zero for the default
+ *	@use_busy_signal: wait for the card to leave the busy state
+ *
+ *	Modifies the EXT_CSD register for selected card.  Without
+ *	@use_busy_signal the command returns as soon as the card took it,
+ *	which is used to start operations that run in the background.
+ */
+int __mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value,
+		 unsigned int timeout_ms, bool use_busy_signal)
 {
 	int err;
 	struct mmc_command cmd;
 	u32 status;
+	bool busy_timedout = false;
 
 	BUG_ON(!card);
 	BUG_ON(!card->host);
@@ -403,18 +419,40 @@ int mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value)
 		  (index << 16) |
 		  (value << 8) |
 		  set;
-	cmd.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	if (use_busy_signal)
+		cmd.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	else
+		cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_AC;
+	cmd.cmd_timeout_ms = timeout_ms;
 
-	err = mmc_wait_for_cmd(card->host, &cmd, MMC_CMD_RETRIES);
+	if (timeout_ms) {
+		/*
+		 * Do not retry a long operation the card may still be busy
+		 * with; if the host gives up on the busy signal, wait for
+		 * the card by polling its status instead.
+		 */
+		err = mmc_wait_for_cmd(card->host, &cmd, 0);
+		if (err == -ETIMEDOUT && use_busy_signal &&
+		    !mmc_host_is_spi(card->host)) {
+			busy_timedout = true;
+			err = 0;
+		}
+	} else
+		err = mmc_wait_for_cmd(card->host, &cmd, MMC_CMD_RETRIES);
 	if (err)
 		return err;
 
+	/* No need to check card status in case of unblocking command */
+	if (!use_busy_signal)
+		return 0;
+
 	/* Must check status to be sure of no errors */
 	do {
 		err = mmc_send_status(card, &status);
 		if (err)
 			return err;
-		if (card->host->caps & MMC_CAP_WAIT_WHILE_BUSY)
+		if ((card->host->caps & MMC_CAP_WAIT_WHILE_BUSY) &&
+		    !busy_timedout)
 			break;
 		if (mmc_host_is_spi(card->host))
 			break;
@@ -434,6 +472,11 @@ int mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value)
 	return 0;
 }
 
+int mmc_switch(struct mmc_card *card, u8 set, u8 index, u8 value)
+{
+	return __mmc_switch(card, set, index, value, 0, true);
+}
+
 int mmc_send_status(struct mmc_card *card, u32 *status)
 {
 	int err;
@@ -462,3 +505,39 @@ int mmc_send_status(struct mmc_card *card, u32 *status)
 	return 0;
 }
 
+/*
+ * Send a High Priority Interrupt, which makes the card abandon the
+ * operation it is busy with (e.g. background operations) early.
+ */
+int mmc_send_hpi_cmd(struct mmc_card *card, u32 *status)
+{
+	struct mmc_command cmd;
+	unsigned int opcode;
+	int err;
+
+	if (!card->ext_csd.hpi_en)
+		return -EINVAL;
+
+	opcode = card->ext_csd.hpi_cmd;
+
+	memset(&cmd, 0, sizeof(struct mmc_command));
+	cmd.opcode = opcode;
+	cmd.arg = card->rca << 16 | 1;
+	if (opcode == MMC_STOP_TRANSMISSION)
+		cmd.flags = MMC_RSP_R1B | MMC_CMD_AC;
+	else
+		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err) {
+		printk(KERN_WARNING "%s: error %d interrupting operation, "
+		       "HPI command response %#x\n", mmc_hostname(card->host),
+		       err, cmd.resp[0]);
+		return err;
+	}
+	if (status)
+		*status = cmd.resp[0];
+
+	return 0;
+}
+
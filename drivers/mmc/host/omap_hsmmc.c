@@ -24,6 +24,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/platform_device.h>
 #include <linux/workqueue.h>
+#include <linux/sched.h>
 #include <linux/timer.h>
 #include <linux/clk.h>
 #include <linux/mmc/host.h>
@@ -172,6 +173,12 @@ struct adma_desc_table {
 	dma_addr_t addr;
 };
 
+/* a request whose data was mapped for DMA ahead of time by pre_req */
+struct omap_hsmmc_next {
+	unsigned int	dma_len;
+	s32		cookie;
+};
+
 struct omap_hsmmc_host {
 	struct	device		*dev;
 	struct	mmc_host	*mmc;
@@ -205,6 +212,7 @@ struct omap_hsmmc_host {
 	unsigned int		id;
 	unsigned int		dma_len;
 	unsigned int		dma_sg_idx;
+	struct omap_hsmmc_next	next_data;
 	unsigned int		master_clock;
 	unsigned char		bus_mode;
 	unsigned char		power_mode;
@@ -1021,6 +1029,78 @@ omap_hsmmc_get_dma_dir(struct omap_hsmmc_host *host, struct mmc_data *data)
 		return DMA_FROM_DEVICE;
 }
 
+/*
+ * Account the CPU time of a dma_map_sg()/dma_unmap_sg(), which is mostly
+ * cache maintenance.  Unmapping can happen from the interrupt handler.
+ */
+static void omap_hsmmc_account_map(struct omap_hsmmc_host *host,
+				   unsigned long long start)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	host->mmc->dma_map_ns += sched_clock() - start;
+	local_irq_restore(flags);
+}
+
+/*
+ * Map the data of a request for DMA.  With @next, this is done ahead of
+ * time from pre_req, and the request is tagged with a cookie so that
+ * the mapping is used when it is started.
+ */
+static int omap_hsmmc_pre_dma_transfer(struct omap_hsmmc_host *host,
+				       struct mmc_data *data,
+				       struct omap_hsmmc_next *next)
+{
+	unsigned long long start;
+	int dma_len;
+
+	if (!next && data->host_cookie &&
+	    data->host_cookie != host->next_data.cookie) {
+		dev_warn(mmc_dev(host->mmc), "invalid cookie: data %d, "
+			 "next %d\n", data->host_cookie,
+			 host->next_data.cookie);
+		data->host_cookie = 0;
+	}
+
+	/* Check if next job is already prepared */
+	if (next || data->host_cookie != host->next_data.cookie) {
+		start = sched_clock();
+		dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
+				     data->sg_len,
+				     omap_hsmmc_get_dma_dir(host, data));
+		omap_hsmmc_account_map(host, start);
+	} else {
+		dma_len = host->next_data.dma_len;
+		host->next_data.dma_len = 0;
+	}
+
+	if (dma_len == 0)
+		return -EINVAL;
+
+	if (next) {
+		next->dma_len = dma_len;
+		data->host_cookie = ++next->cookie < 0 ? 1 : next->cookie;
+	} else
+		host->dma_len = dma_len;
+
+	return 0;
+}
+
+/* Requests mapped by pre_req are unmapped by post_req */
+static void omap_hsmmc_unmap_data(struct omap_hsmmc_host *host,
+				  struct mmc_data *data)
+{
+	unsigned long long start;
+
+	if (!data->host_cookie) {
+		start = sched_clock();
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, host->dma_len,
+			     omap_hsmmc_get_dma_dir(host, data));
+		omap_hsmmc_account_map(host, start);
+	}
+}
+
 static void omap_hsmmc_request_done(struct omap_hsmmc_host *host,
 					struct mmc_request *mrq)
 {
@@ -1062,8 +1142,7 @@ omap_hsmmc_xfer_done(struct omap_hsmmc_host *host, struct mmc_data *data)
 	host->data = NULL;
 
 	if (host->dma_type == ADMA_XFER)
-		dma_unmap_sg(mmc_dev(host->mmc), data->sg, host->dma_len,
-					omap_hsmmc_get_dma_dir(host, data));
+		omap_hsmmc_unmap_data(host, data);
 
 	if (!data->error)
 		data->bytes_xfered += data->blocks * (data->blksz);
@@ -1116,8 +1195,7 @@ static void omap_hsmmc_dma_cleanup(struct omap_hsmmc_host *host, int errno)
 	spin_unlock(&host->irq_lock);
 
 	if ((host->dma_type == SDMA_XFER) && (dma_ch != -1)) {
-		dma_unmap_sg(mmc_dev(host->mmc), host->data->sg, host->dma_len,
-			omap_hsmmc_get_dma_dir(host, host->data));
+		omap_hsmmc_unmap_data(host, host->data);
 		omap_free_dma(dma_ch);
 	}
 	host->data = NULL;
@@ -1565,8 +1643,7 @@ static void omap_hsmmc_dma_cb(int lch, u16 ch_status, void *cb_data)
 		return;
 	}
 
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg, host->dma_len,
-		omap_hsmmc_get_dma_dir(host, data));
+	omap_hsmmc_unmap_data(host, data);
 
 	req_in_progress = host->req_in_progress;
 	dma_ch = host->dma_ch;
@@ -1634,8 +1711,11 @@ static int omap_hsmmc_start_sdma_transfer(struct omap_hsmmc_host *host,
 		return ret;
 	}
 
-	host->dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
-			data->sg_len, omap_hsmmc_get_dma_dir(host, data));
+	ret = omap_hsmmc_pre_dma_transfer(host, data, NULL);
+	if (ret) {
+		omap_free_dma(dma_ch);
+		return ret;
+	}
 	host->dma_ch = dma_ch;
 	host->dma_sg_idx = 0;
 
@@ -1653,8 +1733,8 @@ static int mmc_populate_adma_desc_table(struct omap_hsmmc_host *host,
 	dma_addr_t dmaaddr;
 	struct mmc_data *data = req->data;
 
-	host->dma_len = dma_map_sg(mmc_dev(host->mmc), data->sg,
-			data->sg_len, omap_hsmmc_get_dma_dir(host, data));
+	if (omap_hsmmc_pre_dma_transfer(host, data, NULL))
+		return 0;
 	for (i = 0, j = 0; i < host->dma_len; i++) {
 		dmaaddr = sg_dma_address(data->sg + i);
 		dmalen = sg_dma_len(data->sg + i);
@@ -1755,10 +1835,17 @@ omap_hsmmc_prepare_data(struct omap_hsmmc_host *host, struct mmc_request *req)
 		OMAP_HSMMC_WRITE(host, BLK, 0);
 		/*
 		 * Set an arbitrary 100ms data timeout for commands with
-		 * busy signal.
+		 * busy signal, or the command timeout of long ones such as
+		 * erases and cache flushes.  The controller cannot wait for
+		 * more than a few seconds, the core polls the card status
+		 * if a command outlasts that.
 		 */
-		if (req->cmd->flags & MMC_RSP_BUSY)
-			set_data_timeout(host, 100000000U, 0);
+		if (req->cmd->flags & MMC_RSP_BUSY) {
+			unsigned int timeout_ms = req->cmd->cmd_timeout_ms;
+
+			timeout_ms = clamp(timeout_ms, 100U, 4000U);
+			set_data_timeout(host, timeout_ms * 1000000U, 0);
+		}
 		return 0;
 	}
 
@@ -2138,6 +2225,12 @@ static int omap_hsmmc_disabled_to_sleep(struct omap_hsmmc_host *host)
 
 	if (mmc_card_can_sleep(host->mmc)) {
 		err = mmc_card_sleep(host->mmc);
+		if (err == -EBUSY) {
+			/* The card is doing BKOPS, try again later */
+			pm_runtime_put_sync(host->dev);
+			mmc_release_host(host->mmc);
+			return OMAP_MMC_SLEEP_TIMEOUT;
+		}
 		if (err < 0) {
 			clk_disable(host->fclk);
 			mmc_release_host(host->mmc);
@@ -2416,9 +2509,50 @@ static int omap_hsmmc_disable_simple(struct mmc_host *mmc, int lazy)
 	return 0;
 }
 
+/*
+ * Map the data of the next request while the current one is being
+ * transferred, so that the cache maintenance is off the critical path.
+ */
+static void omap_hsmmc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			       bool is_first_req)
+{
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+
+	if (!mrq->data)
+		return;
+
+	if (mrq->data->host_cookie) {
+		mrq->data->host_cookie = 0;
+		return;
+	}
+
+	if (host->dma_type == SDMA_XFER || host->dma_type == ADMA_XFER)
+		if (omap_hsmmc_pre_dma_transfer(host, mrq->data,
+						&host->next_data))
+			mrq->data->host_cookie = 0;
+}
+
+static void omap_hsmmc_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+				int err)
+{
+	struct omap_hsmmc_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	unsigned long long start;
+
+	if (data && data->host_cookie) {
+		start = sched_clock();
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
+			     omap_hsmmc_get_dma_dir(host, data));
+		omap_hsmmc_account_map(host, start);
+		data->host_cookie = 0;
+	}
+}
+
 static const struct mmc_host_ops omap_hsmmc_ops = {
 	.enable = omap_hsmmc_enable_simple,
 	.disable = omap_hsmmc_disable_simple,
+	.post_req = omap_hsmmc_post_req,
+	.pre_req = omap_hsmmc_pre_req,
 	.request = omap_hsmmc_request,
 	.set_ios = omap_hsmmc_set_ios,
 	.get_cd = omap_hsmmc_get_cd,
@@ -2429,6 +2563,8 @@ static const struct mmc_host_ops omap_hsmmc_ops = {
 static const struct mmc_host_ops omap_hsmmc_ps_ops = {
 	.enable = omap_hsmmc_enable,
 	.disable = omap_hsmmc_disable,
+	.post_req = omap_hsmmc_post_req,
+	.pre_req = omap_hsmmc_pre_req,
 	.request = omap_hsmmc_request,
 	.set_ios = omap_hsmmc_set_ios,
 	.get_cd = omap_hsmmc_get_cd,
@@ -2621,6 +2757,7 @@ static int __init omap_hsmmc_probe(struct platform_device *pdev)
 	host->dma_type	= SDMA_XFER;
 	host->dev->dma_mask = &pdata->dma_mask;
 	host->dma_ch	= -1;
+	host->next_data.cookie = 1;
 	host->irq	= irq;
 	host->id	= pdev->id;
 	host->slot_id	= 0;
@@ -2767,6 +2904,16 @@ static int __init omap_hsmmc_probe(struct platform_device *pdev)
 	mmc->max_req_size = mmc->max_blk_size * mmc->max_blk_count;
 	mmc->max_seg_size = mmc->max_req_size;
 
+	/*
+	 * ADMA walks the sg list from its descriptor table: one segment
+	 * per descriptor, so that no request can overflow the table.
+	 */
+	if (host->dma_type == ADMA_XFER) {
+		mmc->max_phys_segs = ADMA_TABLE_NUM_ENTRIES;
+		mmc->max_hw_segs = ADMA_TABLE_NUM_ENTRIES;
+		mmc->max_seg_size = ADMA_MAX_XFER_PER_ROW;
+	}
+
 	mmc->caps |= MMC_CAP_MMC_HIGHSPEED | MMC_CAP_SD_HIGHSPEED |
 		     MMC_CAP_WAIT_WHILE_BUSY | MMC_CAP_ERASE;
 
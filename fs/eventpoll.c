@@ -207,10 +207,17 @@ struct ep_pqueue {
 	struct epitem *epi;
 };
 
+/* Number of ready events copied to userspace at once */
+#define EP_SEND_BATCH 16
+
 /* Used by the ep_send_events() function as callback private data */
 struct ep_send_events_data {
 	int maxevents;
 	struct epoll_event __user *events;
+
+	/* Ready events waiting to be copied, and the items they came from */
+	struct epoll_event kevents[EP_SEND_BATCH];
+	struct epitem *kitems[EP_SEND_BATCH];
 };
 
 /*
@@ -1040,22 +1047,69 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	return 0;
 }
 
+/*
+ * Copies the first @n events of the batch in @esed to userspace and
+ * completes the delivery of the items they came from.  Items whose
+ * event did not make it are put back on @head.  Returns the number of
+ * events delivered.
+ */
+static int ep_flush_events(struct eventpoll *ep, struct list_head *head,
+			   struct ep_send_events_data *esed, int n)
+{
+	struct epitem *epi;
+	unsigned long left;
+	int i, done;
+
+	left = __copy_to_user(esed->events, esed->kevents,
+			      n * sizeof(struct epoll_event));
+	done = n - DIV_ROUND_UP(left, sizeof(struct epoll_event));
+
+	/* put back the tail of the batch, keeping the original order */
+	for (i = n - 1; i >= done; i--)
+		list_add(&esed->kitems[i]->rdllink, head);
+
+	for (i = 0; i < done; i++) {
+		epi = esed->kitems[i];
+		if (epi->event.events & EPOLLONESHOT)
+			epi->event.events &= EP_PRIVATE_BITS;
+		else if (!(epi->event.events & EPOLLET)) {
+			/*
+			 * If this file has been added with Level
+			 * Trigger mode, we need to insert back inside
+			 * the ready list, so that the next call to
+			 * epoll_wait() will check again the events
+			 * availability. At this point, noone can insert
+			 * into ep->rdllist besides us. The epoll_ctl()
+			 * callers are locked out by
+			 * ep_scan_ready_list() holding "mtx" and the
+			 * poll callback will queue them in ep->ovflist.
+			 */
+			list_add_tail(&epi->rdllink, &ep->rdllist);
+		}
+	}
+
+	esed->events += done;
+	return done;
+}
+
 static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 			       void *priv)
 {
 	struct ep_send_events_data *esed = priv;
-	int eventcnt;
+	int eventcnt, n, done;
 	unsigned int revents;
 	struct epitem *epi;
-	struct epoll_event __user *uevent;
 
 	/*
 	 * We can loop without lock because we are passed a task private list.
 	 * Items cannot vanish during the loop because ep_scan_ready_list() is
 	 * holding "mtx" during this call.
+	 *
+	 * Ready events are collected in a small kernel buffer and copied to
+	 * userspace a batch at a time, instead of two __put_user() per event.
 	 */
-	for (eventcnt = 0, uevent = esed->events;
-	     !list_empty(head) && eventcnt < esed->maxevents;) {
+	for (eventcnt = 0, n = 0;
+	     !list_empty(head) && eventcnt + n < esed->maxevents;) {
 		epi = list_first_entry(head, struct epitem, rdllink);
 
 		list_del_init(&epi->rdllink);
@@ -1069,31 +1123,27 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 		 * is holding "mtx", so no operations coming from userspace
 		 * can change the item.
 		 */
-		if (revents) {
-			if (__put_user(revents, &uevent->events) ||
-			    __put_user(epi->event.data, &uevent->data)) {
-				list_add(&epi->rdllink, head);
-				return eventcnt ? eventcnt : -EFAULT;
-			}
-			eventcnt++;
-			uevent++;
-			if (epi->event.events & EPOLLONESHOT)
-				epi->event.events &= EP_PRIVATE_BITS;
-			else if (!(epi->event.events & EPOLLET)) {
-				/*
-				 * If this file has been added with Level
-				 * Trigger mode, we need to insert back inside
-				 * the ready list, so that the next call to
-				 * epoll_wait() will check again the events
-				 * availability. At this point, noone can insert
-				 * into ep->rdllist besides us. The epoll_ctl()
-				 * callers are locked out by
-				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
-				 */
-				list_add_tail(&epi->rdllink, &ep->rdllist);
-			}
-		}
+		if (!revents)
+			continue;
+
+		esed->kevents[n].events = revents;
+		esed->kevents[n].data = epi->event.data;
+		esed->kitems[n] = epi;
+		if (++n < EP_SEND_BATCH)
+			continue;
+
+		done = ep_flush_events(ep, head, esed, n);
+		eventcnt += done;
+		if (done < n)
+			return eventcnt ? eventcnt : -EFAULT;
+		n = 0;
+	}
+
+	if (n) {
+		done = ep_flush_events(ep, head, esed, n);
+		eventcnt += done;
+		if (done < n)
+			return eventcnt ? eventcnt : -EFAULT;
 	}
 
 	return eventcnt;
@@ -806,6 +806,11 @@ struct ext4_inode_info {
 	struct list_head i_prealloc_list;
 	spinlock_t i_prealloc_lock;
 
+	/* growth rate of the file, protected by i_data_sem */
+	unsigned long i_mb_rate_time;	/* jiffies of the last sample */
+	ext4_lblk_t i_mb_rate_lblk;	/* end of the file at that time */
+	unsigned int i_mb_rate;		/* blocks per second */
+
 	/* ialloc */
 	ext4_group_t	i_last_alloc_group;
 
@@ -883,10 +888,12 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
 #define EXT4_MOUNT_I_VERSION            0x2000000 /* i_version support */
+#define EXT4_MOUNT_FSYNC_DATA		0x4000000 /* fsync() like fdatasync() */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
 #define EXT4_MOUNT_DISCARD		0x40000000 /* Issue DISCARD requests */
+#define EXT4_MOUNT_INIT_INODE_TABLE	0x80000000 /* Zero uninit itables */
 
 #define clear_opt(o, opt)		o &= ~EXT4_MOUNT_##opt
 #define set_opt(o, opt)			o |= EXT4_MOUNT_##opt
@@ -1016,6 +1023,9 @@ struct ext4_super_block {
 #define EXT4_MF_MNTDIR_SAMPLED	0x0001
 #define EXT4_MF_FS_ABORTED	0x0002	/* Fatal error detected */
 
+/* 1, 2, 3-4, 5-8, ..., 33-64 and more than 64 extents */
+#define EXT4_EXTENTS_HIST_SIZE	8
+
 /*
  * fourth extended-fs super-block data in memory
  */
@@ -1111,6 +1121,8 @@ struct ext4_sb_info {
 	unsigned int s_mb_stats;
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
+	unsigned int s_mb_window_ms;
+	unsigned int s_mb_max_window;
 	unsigned int s_max_writeback_mb_bump;
 	/* where last allocation was done - for stream allocation */
 	unsigned long s_mb_last_group;
@@ -1133,6 +1145,9 @@ struct ext4_sb_info {
 	atomic_t s_mb_discarded;
 	atomic_t s_lock_busy;
 
+	/* extents per file, counted when written inodes leave the cache */
+	atomic_t s_extents_hist[EXT4_EXTENTS_HIST_SIZE];
+
 	/* locality groups */
 	struct ext4_locality_group __percpu *s_locality_groups;
 
@@ -1145,6 +1160,10 @@ struct ext4_sb_info {
 
 	/* workqueue for dio unwritten */
 	struct workqueue_struct *dio_unwritten_wq;
+
+	/* lazy inode table initialization */
+	struct ext4_li_request *s_li_request;
+	unsigned int s_li_wait_mult;
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1183,6 +1202,7 @@ enum {
 	EXT4_STATE_EXT_MIGRATE,		/* Inode is migrating */
 	EXT4_STATE_DIO_UNWRITTEN,	/* need convert on dio done*/
 	EXT4_STATE_NEWENTRY,		/* File just added to dir */
+	EXT4_STATE_MB_ALLOCATED,	/* Data blocks allocated while cached */
 };
 
 #define EXT4_INODE_BIT_FNS(name, field)					\
@@ -1322,6 +1342,22 @@ EXT4_INODE_BIT_FNS(state, state_flags)
 #define EXT4_DEF_MIN_BATCH_TIME	0
 #define EXT4_DEF_MAX_BATCH_TIME	15000 /* 15ms */
 
+/*
+ * Lazy inode table initialization: after zeroing a group, the thread
+ * waits EXT4_DEF_LI_WAIT_MULT times as long as that took.  It starts
+ * within EXT4_DEF_LI_MAX_START_DELAY seconds of the mount.
+ */
+#define EXT4_DEF_LI_WAIT_MULT		10
+#define EXT4_DEF_LI_MAX_START_DELAY	5
+
+/* Per-fs request to the lazyinit thread */
+struct ext4_li_request {
+	struct super_block	*lr_super;
+	ext4_group_t		lr_next_group;
+	struct list_head	lr_request;
+	unsigned long		lr_next_sched;	/* jiffies */
+};
+
 /*
  * Minimum number of groups in a flexgroup before we separate out
  * directories into the first block group of a flexgroup
@@ -1540,6 +1576,7 @@ extern unsigned ext4_init_inode_bitmap(struct super_block *sb,
 				       ext4_group_t group,
 				       struct ext4_group_desc *desc);
 extern void mark_bitmap_end(int start_bit, int end_bit, char *bitmap);
+extern int ext4_init_inode_table(struct super_block *sb, ext4_group_t group);
 
 /* mballoc.c */
 extern long ext4_mb_stats;
@@ -1899,6 +1936,7 @@ extern int ext4_ext_index_trans_blocks(struct inode *inode, int nrblocks,
 extern int ext4_ext_map_blocks(handle_t *handle, struct inode *inode,
 			       struct ext4_map_blocks *map, int flags);
 extern void ext4_ext_truncate(struct inode *);
+extern void ext4_ext_account_fragments(struct inode *inode);
 extern void ext4_ext_init(struct super_block *);
 extern void ext4_ext_release(struct super_block *);
 extern long ext4_fallocate(struct inode *inode, int mode, loff_t offset,
@@ -3640,6 +3640,80 @@ out_stop:
 	ext4_journal_stop(handle);
 }
 
+struct ext4_fragment_count {
+	unsigned int	fragments;
+	ext4_fsblk_t	next_pblk;
+};
+
+/*
+ * Count the physically discontiguous runs of blocks below @eh.  Index
+ * blocks are only looked up in the buffer cache: this runs when inodes
+ * are evicted, where waiting for metadata reads is not wanted, so
+ * -EAGAIN is returned if one of them is not cached.
+ */
+static int ext4_ext_count_fragments(struct inode *inode,
+				    struct ext4_extent_header *eh, int depth,
+				    struct ext4_fragment_count *fc)
+{
+	struct ext4_extent_idx *ix;
+	struct ext4_extent *ex;
+	struct buffer_head *bh;
+	int i, err;
+
+	if (depth == 0) {
+		ex = EXT_FIRST_EXTENT(eh);
+		for (i = 0; i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+			if (!fc->fragments || ext_pblock(ex) != fc->next_pblk)
+				fc->fragments++;
+			fc->next_pblk = ext_pblock(ex) +
+					ext4_ext_get_actual_len(ex);
+		}
+		return 0;
+	}
+
+	ix = EXT_FIRST_INDEX(eh);
+	for (i = 0; i < le16_to_cpu(eh->eh_entries); i++, ix++) {
+		bh = sb_find_get_block(inode->i_sb, idx_pblock(ix));
+		if (!bh)
+			return -EAGAIN;
+		if (!buffer_uptodate(bh)) {
+			brelse(bh);
+			return -EAGAIN;
+		}
+		err = ext4_ext_check(inode, ext_block_hdr(bh), depth - 1);
+		if (!err)
+			err = ext4_ext_count_fragments(inode, ext_block_hdr(bh),
+						       depth - 1, fc);
+		brelse(bh);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+/*
+ * Add a file to the extents_per_file histogram of its filesystem.
+ * Called when an inode that had blocks allocated to it is evicted.
+ * Files whose extent tree is not fully in memory are not counted.
+ */
+void ext4_ext_account_fragments(struct inode *inode)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(inode->i_sb);
+	struct ext4_fragment_count fc = { 0, 0 };
+	int bucket;
+
+	down_read(&EXT4_I(inode)->i_data_sem);
+	if (ext4_ext_count_fragments(inode, ext_inode_hdr(inode),
+				     ext_depth(inode), &fc))
+		fc.fragments = 0;
+	up_read(&EXT4_I(inode)->i_data_sem);
+	if (!fc.fragments)
+		return;
+
+	bucket = min(fls(fc.fragments - 1), EXT4_EXTENTS_HIST_SIZE - 1);
+	atomic_inc(&sbi->s_extents_hist[bucket]);
+}
+
 static void ext4_falloc_update_inode(struct inode *inode,
 				int mode, loff_t new_size, int update_ctime)
 {
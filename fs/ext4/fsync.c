@@ -114,8 +114,16 @@ int ext4_sync_file(struct file *file, int datasync)
 	if (ext4_should_journal_data(inode))
 		return ext4_force_commit(inode->i_sb);
 
+	/*
+	 * With fsync=data, timestamp updates alone don't force a commit.
+	 * Rewriting data in place, as databases do, then costs a cache
+	 * flush instead of a journal commit.
+	 */
+	if (test_opt(inode->i_sb, FSYNC_DATA))
+		datasync = 1;
+
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
-	if (jbd2_log_start_commit(journal, commit_tid)) {
+	if (jbd2_log_start_commit_batched(journal, commit_tid)) {
 		/*
 		 * When the journal is on a different device than the
 		 * fs data disk, we need to issue the barrier in
@@ -130,8 +138,16 @@ int ext4_sync_file(struct file *file, int datasync)
 			blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL,
 					NULL, BLKDEV_IFL_WAIT);
 		ret = jbd2_log_wait_commit(journal, commit_tid);
-	} else if (journal->j_flags & JBD2_BARRIER)
-		blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL,
-			BLKDEV_IFL_WAIT);
+	} else {
+		/*
+		 * The transaction is committed, or another task already
+		 * asked for the commit and may not have finished it.  Wait
+		 * for it, then flush the data we wrote after it started.
+		 */
+		ret = jbd2_log_wait_commit(journal, commit_tid);
+		if (journal->j_flags & JBD2_BARRIER)
+			blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL,
+					NULL, BLKDEV_IFL_WAIT);
+	}
 	return ret;
 }
@@ -712,8 +712,15 @@ static int ext4_claim_inode(struct super_block *sb,
 {
 	int free = 0, retval = 0, count;
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_info *grp = ext4_get_group_info(sb, group);
 	struct ext4_group_desc *gdp = ext4_get_group_desc(sb, group, NULL);
 
+	/*
+	 * The lazyinit thread zeroes the unused part of the inode table
+	 * with alloc_sem held for writing, so an inode claimed here is
+	 * either outside of what it zeroes or claimed after it is done.
+	 */
+	down_read(&grp->alloc_sem);
 	ext4_lock_group(sb, group);
 	if (ext4_set_bit(ino, inode_bitmap_bh->b_data)) {
 		/* not a free inode */
@@ -724,6 +731,7 @@ static int ext4_claim_inode(struct super_block *sb,
 	if ((group == 0 && ino < EXT4_FIRST_INO(sb)) ||
 			ino > EXT4_INODES_PER_GROUP(sb)) {
 		ext4_unlock_group(sb, group);
+		up_read(&grp->alloc_sem);
 		ext4_error(sb, "reserved inode or inode > inodes count - "
 			   "block_group = %u, inode=%lu", group,
 			   ino + group * EXT4_INODES_PER_GROUP(sb));
@@ -772,6 +780,7 @@ static int ext4_claim_inode(struct super_block *sb,
 	gdp->bg_checksum = ext4_group_desc_csum(sbi, group, gdp);
 err_ret:
 	ext4_unlock_group(sb, group);
+	up_read(&grp->alloc_sem);
 	return retval;
 }
 
@@ -1205,3 +1214,86 @@ unsigned long ext4_count_dirs(struct super_block * sb)
 	}
 	return count;
 }
+
+/*
+ * Zero the part of the inode table of @group that mke2fs left
+ * uninitialized, and mark the group EXT4_BG_INODE_ZEROED.  This is only
+ * called from the lazyinit thread.  Inode allocation in the group is
+ * blocked by alloc_sem while we work, see ext4_claim_inode().
+ */
+int ext4_init_inode_table(struct super_block *sb, ext4_group_t group)
+{
+	struct ext4_group_info *grp = ext4_get_group_info(sb, group);
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *group_desc_bh;
+	handle_t *handle;
+	ext4_fsblk_t blk;
+	int num, ret = 0, used_blks = 0;
+
+	/* the thread is stopped before the fs goes read-only */
+	if (sb->s_flags & MS_RDONLY)
+		return 1;
+
+	gdp = ext4_get_group_desc(sb, group, &group_desc_bh);
+	if (!gdp)
+		return 0;
+
+	/* nobody else sets this flag, no need to lock */
+	if (gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED))
+		return 0;
+
+	handle = ext4_journal_start_sb(sb, 1);
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	down_write(&grp->alloc_sem);
+	/*
+	 * Once the inode bitmap is initialized, inodes may be in use at
+	 * the start of the table.  Leave the blocks holding them alone.
+	 */
+	if (!(gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_UNINIT)))
+		used_blks = DIV_ROUND_UP((EXT4_INODES_PER_GROUP(sb) -
+				ext4_itable_unused_count(sb, gdp)),
+				sbi->s_inodes_per_block);
+
+	if (used_blks < 0 || used_blks > sbi->s_itb_per_group) {
+		ext4_error(sb, "bad itable unused count %u in group %u",
+			   ext4_itable_unused_count(sb, gdp), group);
+		ret = 1;
+		goto err_out;
+	}
+
+	blk = ext4_inode_table(sb, gdp) + used_blks;
+	num = sbi->s_itb_per_group - used_blks;
+
+	BUFFER_TRACE(group_desc_bh, "get_write_access");
+	ret = ext4_journal_get_write_access(handle, group_desc_bh);
+	if (ret)
+		goto err_out;
+
+	/*
+	 * The zeroes are on the media once this returns.  The journal
+	 * commit that carries the new flag flushes the device cache first
+	 * when barriers are enabled, so no flush is needed here.
+	 */
+	if (num) {
+		ext4_debug("zeroing inode table of group %u\n", group);
+		ret = sb_issue_zeroout(sb, blk, num, GFP_NOFS);
+		if (ret < 0)
+			goto err_out;
+	}
+
+	ext4_lock_group(sb, group);
+	gdp->bg_flags |= cpu_to_le16(EXT4_BG_INODE_ZEROED);
+	gdp->bg_checksum = ext4_group_desc_csum(sbi, group, gdp);
+	ext4_unlock_group(sb, group);
+
+	BUFFER_TRACE(group_desc_bh, "call ext4_handle_dirty_metadata");
+	ret = ext4_handle_dirty_metadata(handle, NULL, group_desc_bh);
+
+err_out:
+	up_write(&grp->alloc_sem);
+	ext4_journal_stop(handle);
+	return ret;
+}
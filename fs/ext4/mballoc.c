@@ -2236,6 +2236,39 @@ static const struct file_operations ext4_mb_seq_groups_fops = {
 	.release	= seq_release,
 };
 
+static int ext4_mb_seq_extents_show(struct seq_file *seq, void *v)
+{
+	struct ext4_sb_info *sbi = EXT4_SB((struct super_block *)seq->private);
+	int i, files;
+
+	seq_printf(seq, "#extents    files\n");
+	for (i = 0; i < EXT4_EXTENTS_HIST_SIZE; i++) {
+		files = atomic_read(&sbi->s_extents_hist[i]);
+		if (i < 2)
+			seq_printf(seq, "%-11d %d\n", i + 1, files);
+		else if (i < EXT4_EXTENTS_HIST_SIZE - 1)
+			seq_printf(seq, "%5d-%-5d %d\n", (1 << (i - 1)) + 1,
+				   1 << i, files);
+		else
+			seq_printf(seq, "%5d+%5s %d\n", (1 << (i - 1)) + 1,
+				   "", files);
+	}
+	return 0;
+}
+
+static int ext4_mb_seq_extents_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_mb_seq_extents_show, PDE(inode)->data);
+}
+
+static const struct file_operations ext4_mb_seq_extents_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_mb_seq_extents_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 
 /* Create and initialize ext4_group_info data for the given group. */
 int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
@@ -2456,6 +2489,8 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
+	sbi->s_mb_window_ms = MB_DEFAULT_WINDOW_MS;
+	sbi->s_mb_max_window = MB_DEFAULT_MAX_WINDOW;
 
 	sbi->s_locality_groups = alloc_percpu(struct ext4_locality_group);
 	if (sbi->s_locality_groups == NULL) {
@@ -2472,9 +2507,12 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		spin_lock_init(&lg->lg_prealloc_lock);
 	}
 
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
 		proc_create_data("mb_groups", S_IRUGO, sbi->s_proc,
 				 &ext4_mb_seq_groups_fops, sb);
+		proc_create_data("extents_per_file", S_IRUGO, sbi->s_proc,
+				 &ext4_mb_seq_extents_fops, sb);
+	}
 
 	if (sbi->s_journal)
 		sbi->s_journal->j_commit_callback = release_blocks_on_commit;
@@ -2554,8 +2592,10 @@ int ext4_mb_release(struct super_block *sb)
 	}
 
 	free_percpu(sbi->s_locality_groups);
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
+		remove_proc_entry("extents_per_file", sbi->s_proc);
 		remove_proc_entry("mb_groups", sbi->s_proc);
+	}
 
 	return 0;
 }
@@ -2839,6 +2879,54 @@ static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 		current->pid, ac->ac_g_ex.fe_len);
 }
 
+/*
+ * Track how fast a file grows, in blocks per second, from where its
+ * successive data allocations end.  Called with i_data_sem held.
+ */
+static void ext4_mb_update_write_rate(struct ext4_allocation_context *ac)
+{
+	struct ext4_inode_info *ei = EXT4_I(ac->ac_inode);
+	ext4_lblk_t end = ac->ac_o_ex.fe_logical + ac->ac_o_ex.fe_len;
+	unsigned long now = jiffies;
+	unsigned long elapsed = now - ei->i_mb_rate_time;
+	unsigned int rate;
+
+	/* first allocation, a rewrite, or a file that stopped growing */
+	if (!ei->i_mb_rate_time || end <= ei->i_mb_rate_lblk ||
+	    elapsed > MB_RATE_IDLE) {
+		ei->i_mb_rate_time = now;
+		ei->i_mb_rate_lblk = end;
+		ei->i_mb_rate = 0;
+		return;
+	}
+
+	/* too close to the last sample to tell */
+	if (elapsed < HZ / 2)
+		return;
+
+	rate = div_u64((u64)(end - ei->i_mb_rate_lblk) * HZ, elapsed);
+	if (ei->i_mb_rate)
+		ei->i_mb_rate = (rate + ei->i_mb_rate * 3) / 4;
+	else
+		ei->i_mb_rate = rate;
+	ei->i_mb_rate_time = now;
+	ei->i_mb_rate_lblk = end;
+}
+
+/*
+ * How many blocks a file will write in the next s_mb_window_ms at the
+ * rate it has been growing.
+ */
+static ext4_lblk_t ext4_mb_rate_window(struct ext4_allocation_context *ac)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	u64 window;
+
+	window = (u64)EXT4_I(ac->ac_inode)->i_mb_rate * sbi->s_mb_window_ms;
+	window = div_u64(window, MSEC_PER_SEC);
+	return min_t(u64, window, sbi->s_mb_max_window);
+}
+
 /*
  * Normalization means making request better in terms of
  * size and alignment
@@ -2848,7 +2936,7 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 				struct ext4_allocation_request *ar)
 {
 	int bsbits, max;
-	ext4_lblk_t end;
+	ext4_lblk_t end, window;
 	loff_t size, orig_size, start_off;
 	ext4_lblk_t start, orig_start;
 	struct ext4_inode_info *ei = EXT4_I(ac->ac_inode);
@@ -2925,6 +3013,20 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 	orig_size = size = size >> bsbits;
 	orig_start = start = start_off >> bsbits;
 
+	/*
+	 * A file that is still being written to gets room for what it will
+	 * write before its next allocation, so that it lands right after
+	 * this one instead of between the blocks of other files written at
+	 * the same time.
+	 */
+	window = ext4_mb_rate_window(ac);
+	if (window) {
+		end = ac->ac_o_ex.fe_logical + ac->ac_o_ex.fe_len + window;
+		if (end > start + size)
+			size = min_t(loff_t, end - start,
+				     EXT4_BLOCKS_PER_GROUP(ac->ac_sb));
+	}
+
 	/* don't cover already allocated blocks in selected range */
 	if (ar->pleft && start <= ar->lleft) {
 		size -= ar->lleft + 1 - start;
@@ -3974,9 +4076,15 @@ static void ext4_mb_group_or_file(struct ext4_allocation_context *ac)
 		return;
 	}
 
-	/* don't use group allocation for large files */
+	ext4_mb_update_write_rate(ac);
+
+	/*
+	 * don't use group allocation for large files, nor for files
+	 * growing fast enough to need a window of their own
+	 */
 	size = max(size, isize);
-	if (size > sbi->s_mb_stream_request) {
+	if (size > sbi->s_mb_stream_request ||
+	    ext4_mb_rate_window(ac) > sbi->s_mb_stream_request) {
 		ac->ac_flags |= EXT4_MB_STREAM_ALLOC;
 		return;
 	}
@@ -4352,6 +4460,10 @@ repeat:
 		} else {
 			block = ext4_grp_offs_to_block(sb, &ac->ac_b_ex);
 			ar->len = ac->ac_b_ex.fe_len;
+			/* sampled into extents_per_file at eviction */
+			if (ar->flags & EXT4_MB_HINT_DATA)
+				ext4_set_inode_state(ar->inode,
+						     EXT4_STATE_MB_ALLOCATED);
 		}
 	} else {
 		freed  = ext4_mb_discard_preallocations(sb, ac->ac_o_ex.fe_len);
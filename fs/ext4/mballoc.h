@@ -94,6 +94,21 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * a file that keeps growing gets an inode preallocation big enough for
+ * what it writes in MB_DEFAULT_WINDOW_MS at its current rate, up to
+ * MB_DEFAULT_MAX_WINDOW blocks.  Tunable via
+ * /sys/fs/ext4/<partition>/mb_window_ms and mb_max_window
+ */
+#define MB_DEFAULT_WINDOW_MS		5000
+#define MB_DEFAULT_MAX_WINDOW		2048
+
+/*
+ * the write rate of a file that hasn't allocated for this long is
+ * measured again from scratch
+ */
+#define MB_RATE_IDLE			(30 * HZ)
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
@@ -39,6 +39,8 @@
 #include <linux/ctype.h>
 #include <linux/log2.h>
 #include <linux/crc16.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include <asm/uaccess.h>
 
 #include "ext4.h"
@@ -64,6 +66,7 @@ static int ext4_sync_fs(struct super_block *sb, int wait);
 static const char *ext4_decode_error(struct super_block *sb, int errno,
 				     char nbuf[16]);
 static int ext4_remount(struct super_block *sb, int *flags, char *data);
+static void ext4_unregister_li_request(struct super_block *sb);
 static int ext4_statfs(struct dentry *dentry, struct kstatfs *buf);
 static int ext4_unfreeze(struct super_block *sb);
 static void ext4_write_super(struct super_block *sb);
@@ -646,6 +649,7 @@ static void ext4_put_super(struct super_block *sb)
 	struct ext4_super_block *es = sbi->s_es;
 	int i, err;
 
+	ext4_unregister_li_request(sb);
 	dquot_disable(sb, -1, DQUOT_USAGE_ENABLED | DQUOT_LIMITS_ENABLED);
 
 	flush_workqueue(sbi->dio_unwritten_wq);
@@ -746,6 +750,9 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	memset(&ei->i_cached_extent, 0, sizeof(struct ext4_ext_cache));
 	INIT_LIST_HEAD(&ei->i_prealloc_list);
 	spin_lock_init(&ei->i_prealloc_lock);
+	ei->i_mb_rate_time = 0;
+	ei->i_mb_rate_lblk = 0;
+	ei->i_mb_rate = 0;
 	/*
 	 * Note:  We can be called before EXT4_SB(sb)->s_journal is set,
 	 * therefore it can be null here.  Don't check it, just initialize
@@ -815,6 +822,11 @@ static void destroy_inodecache(void)
 
 static void ext4_clear_inode(struct inode *inode)
 {
+	/* sample files that got blocks allocated while in memory */
+	if (S_ISREG(inode->i_mode) && inode->i_nlink &&
+	    ext4_test_inode_state(inode, EXT4_STATE_MB_ALLOCATED) &&
+	    ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS))
+		ext4_ext_account_fragments(inode);
 	dquot_drop(inode);
 	ext4_discard_preallocations(inode);
 	if (EXT4_JOURNAL(inode))
@@ -986,6 +998,14 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, DIOREAD_NOLOCK))
 		seq_puts(seq, ",dioread_nolock");
 
+	if (test_opt(sb, FSYNC_DATA))
+		seq_puts(seq, ",fsync=data");
+
+	if (!test_opt(sb, INIT_INODE_TABLE))
+		seq_puts(seq, ",noinit_itable");
+	else if (sbi->s_li_wait_mult != EXT4_DEF_LI_WAIT_MULT)
+		seq_printf(seq, ",init_itable=%u", sbi->s_li_wait_mult);
+
 	ext4_show_quota_options(seq, sb);
 
 	return 0;
@@ -1161,6 +1181,8 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard,
+	Opt_init_inode_table, Opt_noinit_inode_table,
+	Opt_fsync_strict, Opt_fsync_data,
 };
 
 static const match_table_t tokens = {
@@ -1231,6 +1253,11 @@ static const match_table_t tokens = {
 	{Opt_dioread_lock, "dioread_lock"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_init_inode_table, "init_itable=%u"},
+	{Opt_init_inode_table, "init_itable"},
+	{Opt_noinit_inode_table, "noinit_itable"},
+	{Opt_fsync_strict, "fsync=strict"},
+	{Opt_fsync_data, "fsync=data"},
 	{Opt_err, NULL},
 };
 
@@ -1699,6 +1726,26 @@ set_qf_format:
 		case Opt_dioread_lock:
 			clear_opt(sbi->s_mount_opt, DIOREAD_NOLOCK);
 			break;
+		case Opt_init_inode_table:
+			set_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+			if (args[0].from) {
+				if (match_int(&args[0], &option))
+					return 0;
+			} else
+				option = EXT4_DEF_LI_WAIT_MULT;
+			if (option < 0)
+				return 0;
+			sbi->s_li_wait_mult = option;
+			break;
+		case Opt_noinit_inode_table:
+			clear_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+			break;
+		case Opt_fsync_strict:
+			clear_opt(sbi->s_mount_opt, FSYNC_DATA);
+			break;
+		case Opt_fsync_data:
+			set_opt(sbi->s_mount_opt, FSYNC_DATA);
+			break;
 		default:
 			ext4_msg(sb, KERN_ERR,
 			       "Unrecognized mount option \"%s\" "
@@ -2330,6 +2377,8 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_window_ms, s_mb_window_ms);
+EXT4_RW_ATTR_SBI_UI(mb_max_window, s_mb_max_window);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 
 static struct attribute *ext4_attrs[] = {
@@ -2344,6 +2393,8 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_window_ms),
+	ATTR_LIST(mb_max_window),
 	ATTR_LIST(max_writeback_mb_bump),
 	NULL,
 };
@@ -2431,6 +2482,193 @@ static int ext4_feature_set_ok(struct super_block *sb, int readonly)
 	return 1;
 }
 
+/*
+ * Lazy inode table initialization
+ *
+ * With mke2fs -E lazy_itable_init=1 the inode tables of an uninit_bg
+ * filesystem are left unwritten, so formatting a large partition takes
+ * seconds instead of minutes.  They are zeroed here after mount, by an
+ * "ext4lazyinit" thread shared by all filesystems.  It does one group
+ * at a time and then leaves the filesystem alone s_li_wait_mult times
+ * as long as the group took, so the slower or busier the device, the
+ * more it backs off.  The thread exits when there is nothing left to do.
+ */
+static LIST_HEAD(ext4_li_request_list);
+static DEFINE_MUTEX(ext4_li_mtx);
+static struct task_struct *ext4_li_task;
+
+/* Called with ext4_li_mtx held */
+static void ext4_remove_li_request(struct ext4_li_request *elr)
+{
+	list_del(&elr->lr_request);
+	EXT4_SB(elr->lr_super)->s_li_request = NULL;
+	kfree(elr);
+}
+
+static ext4_group_t ext4_first_unzeroed_group(struct super_block *sb,
+					      ext4_group_t group)
+{
+	ext4_group_t ngroups = EXT4_SB(sb)->s_groups_count;
+	struct ext4_group_desc *gdp;
+
+	for (; group < ngroups; group++) {
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		if (!gdp)
+			return ngroups;
+		if (!(gdp->bg_flags & cpu_to_le16(EXT4_BG_INODE_ZEROED)))
+			break;
+	}
+	return group;
+}
+
+/*
+ * Zero the next group of @elr's filesystem.  Returns nonzero when the
+ * request is finished, either because all groups are done or because
+ * of an error.  Called with ext4_li_mtx held.
+ */
+static int ext4_run_li_request(struct ext4_li_request *elr)
+{
+	struct super_block *sb = elr->lr_super;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ext4_group_t group;
+	unsigned long start;
+	int ret;
+
+	group = ext4_first_unzeroed_group(sb, elr->lr_next_group);
+	if (group >= sbi->s_groups_count)
+		return 1;
+
+	start = jiffies;
+	ret = ext4_init_inode_table(sb, group);
+	if (ret < 0)
+		ext4_msg(sb, KERN_WARNING, "failed to zero the inode table "
+			 "of group %u (%d)", group, ret);
+	if (ret)
+		return ret;
+
+	elr->lr_next_group = group + 1;
+	elr->lr_next_sched = jiffies + (jiffies - start) * sbi->s_li_wait_mult;
+	return 0;
+}
+
+static int ext4_lazyinit_thread(void *arg)
+{
+	struct ext4_li_request *elr, *n;
+	unsigned long next_wakeup = 0, cur;
+	int pending;
+
+	set_freezable();
+	set_user_nice(current, 19);
+	set_task_ioprio(current, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 7));
+
+	while (1) {
+		pending = 0;
+
+		mutex_lock(&ext4_li_mtx);
+		if (list_empty(&ext4_li_request_list)) {
+			ext4_li_task = NULL;
+			mutex_unlock(&ext4_li_mtx);
+			break;
+		}
+		list_for_each_entry_safe(elr, n, &ext4_li_request_list,
+					 lr_request) {
+			if (time_after_eq(jiffies, elr->lr_next_sched) &&
+			    ext4_run_li_request(elr)) {
+				ext4_remove_li_request(elr);
+				continue;
+			}
+			if (!pending ||
+			    time_before(elr->lr_next_sched, next_wakeup)) {
+				next_wakeup = elr->lr_next_sched;
+				pending = 1;
+			}
+		}
+		mutex_unlock(&ext4_li_mtx);
+
+		if (try_to_freeze())
+			continue;
+
+		cur = jiffies;
+		if (!pending || time_after_eq(cur, next_wakeup)) {
+			cond_resched();
+			continue;
+		}
+		schedule_timeout_interruptible(next_wakeup - cur);
+	}
+
+	module_put_and_exit(0);
+	return 0;
+}
+
+/*
+ * Queue @sb for the lazyinit thread if it has inode tables left to
+ * zero, and start the thread if it is not running.
+ */
+static int ext4_register_li_request(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_li_request *elr;
+	struct task_struct *t;
+	ext4_group_t group;
+	int ret = 0;
+
+	if ((sb->s_flags & MS_RDONLY) || !test_opt(sb, INIT_INODE_TABLE) ||
+	    !EXT4_HAS_RO_COMPAT_FEATURE(sb, EXT4_FEATURE_RO_COMPAT_GDT_CSUM))
+		return 0;
+
+	group = ext4_first_unzeroed_group(sb, 0);
+	if (group >= sbi->s_groups_count)
+		return 0;
+
+	mutex_lock(&ext4_li_mtx);
+	if (sbi->s_li_request)
+		goto out;
+
+	elr = kzalloc(sizeof(*elr), GFP_KERNEL);
+	if (!elr) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	elr->lr_super = sb;
+	elr->lr_next_group = group;
+	/* let the boot finish, and don't start all filesystems at once */
+	elr->lr_next_sched = jiffies +
+		random32() % (EXT4_DEF_LI_MAX_START_DELAY * HZ);
+	list_add_tail(&elr->lr_request, &ext4_li_request_list);
+	sbi->s_li_request = elr;
+
+	if (ext4_li_task) {
+		wake_up_process(ext4_li_task);
+		goto out;
+	}
+
+	/* the thread drops this reference when it exits */
+	__module_get(THIS_MODULE);
+	t = kthread_run(ext4_lazyinit_thread, NULL, "ext4lazyinit");
+	if (IS_ERR(t)) {
+		module_put(THIS_MODULE);
+		ext4_remove_li_request(elr);
+		ret = PTR_ERR(t);
+		goto out;
+	}
+	ext4_li_task = t;
+out:
+	mutex_unlock(&ext4_li_mtx);
+	return ret;
+}
+
+/*
+ * Drop the request of @sb.  Once this returns the thread is no longer
+ * working on @sb, so it can be unmounted or remounted read-only.
+ */
+static void ext4_unregister_li_request(struct super_block *sb)
+{
+	mutex_lock(&ext4_li_mtx);
+	if (EXT4_SB(sb)->s_li_request)
+		ext4_remove_li_request(EXT4_SB(sb)->s_li_request);
+	mutex_unlock(&ext4_li_mtx);
+}
+
 static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 				__releases(kernel_lock)
 				__acquires(kernel_lock)
@@ -2554,6 +2792,8 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	sbi->s_max_batch_time = EXT4_DEF_MAX_BATCH_TIME;
 
 	set_opt(sbi->s_mount_opt, BARRIER);
+	set_opt(sbi->s_mount_opt, INIT_INODE_TABLE);
+	sbi->s_li_wait_mult = EXT4_DEF_LI_WAIT_MULT;
 
 	/*
 	 * enable delayed allocation by default
@@ -2940,7 +3180,8 @@ no_journal:
 			goto failed_mount_wq;
 		}
 	}
-	EXT4_SB(sb)->dio_unwritten_wq = create_workqueue("ext4-dio-unwritten");
+	EXT4_SB(sb)->dio_unwritten_wq = alloc_workqueue("ext4-dio-unwritten",
+							WQ_RESCUER, 1);
 	if (!EXT4_SB(sb)->dio_unwritten_wq) {
 		printk(KERN_ERR "EXT4-fs: failed to create DIO workqueue\n");
 		goto failed_mount_wq;
@@ -3048,6 +3289,12 @@ no_journal:
 		ext4_msg(sb, KERN_INFO, "recovery complete");
 		ext4_mark_recovery_complete(sb, es);
 	}
+
+	err = ext4_register_li_request(sb);
+	if (err)
+		ext4_msg(sb, KERN_WARNING, "can't start zeroing uninitialized "
+			 "inode tables (%d)", err);
+
 	if (EXT4_SB(sb)->s_journal) {
 		if (test_opt(sb, DATA_FLAGS) == EXT4_MOUNT_JOURNAL_DATA)
 			descr = " journalled data mode";
@@ -3744,6 +3991,11 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	if (enable_quota)
 		dquot_resume(sb, -1);
 
+	if ((sb->s_flags & MS_RDONLY) || !test_opt(sb, INIT_INODE_TABLE))
+		ext4_unregister_li_request(sb);
+	else
+		ext4_register_li_request(sb);
+
 	ext4_msg(sb, KERN_INFO, "re-mounted. Opts: %s", orig_data);
 	kfree(orig_data);
 	return 0;
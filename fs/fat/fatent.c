@@ -7,6 +7,8 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/bitmap.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -456,6 +458,127 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+/*
+ * The free cluster map is a bitmap of the clusters in use, read from the
+ * FAT in the background after mount.  Once the whole FAT has been read,
+ * allocation searches the bitmap instead of reading the FAT.  Both are
+ * protected by ->fat_lock.
+ */
+static inline int fat_free_map_valid(struct msdos_sb_info *sbi)
+{
+	return sbi->free_map && sbi->free_map_scanned == sbi->max_cluster;
+}
+
+static inline void fat_free_map_set(struct msdos_sb_info *sbi, int entry)
+{
+	if (sbi->free_map)
+		__set_bit(entry, sbi->free_map);
+}
+
+static inline void fat_free_map_clear(struct msdos_sb_info *sbi, int entry)
+{
+	if (sbi->free_map)
+		__clear_bit(entry, sbi->free_map);
+}
+
+/* Next free cluster from @entry on, wrapping around.  max_cluster if none */
+static int fat_free_map_next(struct msdos_sb_info *sbi, int entry)
+{
+	unsigned long next;
+
+	next = find_next_zero_bit(sbi->free_map, sbi->max_cluster, entry);
+	if (next >= sbi->max_cluster)
+		next = find_next_zero_bit(sbi->free_map, sbi->max_cluster,
+					  FAT_START_ENT);
+	return next;
+}
+
+/*
+ * Where to start allocating @nr_cluster clusters: the first run of that
+ * many free clusters after the last allocation, else the first free one.
+ */
+static int fat_free_map_find(struct msdos_sb_info *sbi, int nr_cluster)
+{
+	unsigned long start = sbi->prev_free + 1;
+	unsigned long entry;
+
+	if (nr_cluster > 1) {
+		entry = bitmap_find_next_zero_area(sbi->free_map,
+						   sbi->max_cluster, start,
+						   nr_cluster, 0);
+		if (entry < sbi->max_cluster)
+			return entry;
+	}
+	return fat_free_map_next(sbi, start);
+}
+
+static int fat_alloc_clusters_map(struct inode *inode, int *cluster,
+				  int nr_cluster, struct buffer_head **bhs,
+				  int *nr_bhs, int *idx_clus)
+{
+	struct super_block *sb = inode->i_sb;
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent, prev_ent;
+	int entry, err = 0;
+
+	fatent_init(&prev_ent);
+	fatent_init(&fatent);
+	entry = fat_free_map_find(sbi, nr_cluster);
+	while (entry < sbi->max_cluster) {
+		err = fat_ent_read(inode, &fatent, entry);
+		if (err < 0)
+			goto out;
+		if (err != FAT_ENT_FREE) {
+			/* the map is stale here, fix it and look further */
+			if (printk_ratelimit())
+				printk(KERN_WARNING "FAT: free cluster map is "
+				       "out of sync (entry 0x%08x)\n", entry);
+			__set_bit(entry, sbi->free_map);
+			if (sbi->free_clusters != -1 && sbi->free_clusters)
+				sbi->free_clusters--;
+			entry = fat_free_map_next(sbi, entry + 1);
+			continue;
+		}
+
+		/* make the cluster chain */
+		ops->ent_put(&fatent, FAT_ENT_EOF);
+		if (prev_ent.nr_bhs)
+			ops->ent_put(&prev_ent, entry);
+
+		fat_collect_bhs(bhs, nr_bhs, &fatent);
+
+		__set_bit(entry, sbi->free_map);
+		sbi->prev_free = entry;
+		if (sbi->free_clusters != -1)
+			sbi->free_clusters--;
+		sb->s_dirt = 1;
+
+		cluster[*idx_clus] = entry;
+		(*idx_clus)++;
+		if (*idx_clus == nr_cluster) {
+			err = 0;
+			goto out;
+		}
+
+		/*
+		 * fat_collect_bhs() gets ref-count of bhs,
+		 * so we can still use the prev_ent.
+		 */
+		prev_ent = fatent;
+		entry = fat_free_map_next(sbi, entry + 1);
+	}
+
+	/* Couldn't allocate the free entries */
+	sbi->free_clusters = 0;
+	sbi->free_clus_valid = 1;
+	sb->s_dirt = 1;
+	err = -ENOSPC;
+out:
+	fatent_brelse(&fatent);
+	return err;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -475,6 +598,13 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	}
 
 	err = nr_bhs = idx_clus = 0;
+	if (fat_free_map_valid(sbi)) {
+		err = fat_alloc_clusters_map(inode, cluster, nr_cluster,
+					     bhs, &nr_bhs, &idx_clus);
+		unlock_fat(sbi);
+		goto out_sync;
+	}
+
 	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
 	fatent_init(&fatent);
@@ -499,6 +629,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 
 				fat_collect_bhs(bhs, &nr_bhs, &fatent);
 
+				fat_free_map_set(sbi, entry);
 				sbi->prev_free = entry;
 				if (sbi->free_clusters != -1)
 					sbi->free_clusters--;
@@ -530,6 +661,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 out:
 	unlock_fat(sbi);
 	fatent_brelse(&fatent);
+out_sync:
 	if (!err) {
 		if (inode_needs_sync(inode))
 			err = fat_sync_bhs(bhs, nr_bhs);
@@ -588,6 +720,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_free_map_clear(sbi, fatent.entry);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
@@ -642,6 +775,8 @@ static void fat_ent_reada(struct super_block *sb, struct fat_entry *fatent,
 		sb_breadahead(sb, blocknr + i);
 }
 
+static int fat_free_map_scan(struct super_block *sb);
+
 int fat_count_free_clusters(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -654,6 +789,15 @@ int fat_count_free_clusters(struct super_block *sb)
 	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
 		goto out;
 
+	/* finish filling the free cluster map, which counts them */
+	while (sbi->free_map && !fat_free_map_valid(sbi)) {
+		err = fat_free_map_scan(sb);
+		if (err)
+			goto out;
+	}
+	if (sbi->free_map)
+		goto out;
+
 	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
 	reada_mask = reada_blocks - 1;
 	cur_block = 0;
@@ -686,3 +830,129 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+/* Cap on the memory used by the free cluster map of a filesystem */
+#define FAT_FREE_MAP_MAX	(256 * 1024)
+
+static struct workqueue_struct *fat_free_map_wq;
+
+/*
+ * Read the next FAT_READA_SIZE of the FAT into the free cluster map.
+ * When the whole FAT has been read, this also sets ->free_clusters.
+ */
+static int fat_free_map_scan(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, rest, nr_blocks;
+	sector_t blocknr;
+	int err = 0, offset, free;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, sbi->free_map_scanned);
+
+	ops->ent_blocknr(sb, fatent.entry, &offset, &blocknr);
+	rest = sbi->fat_start + sbi->fat_length - blocknr;
+	fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+
+	nr_blocks = 0;
+	while (fatent.entry < sbi->max_cluster && nr_blocks < reada_blocks) {
+		err = fat_ent_read_block(sb, &fatent);
+		if (err)
+			break;
+		nr_blocks++;
+
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE)
+				__clear_bit(fatent.entry, sbi->free_map);
+			else
+				__set_bit(fatent.entry, sbi->free_map);
+		} while (fat_ent_next(sbi, &fatent));
+	}
+	fatent_brelse(&fatent);
+
+	if (err) {
+		/* fall back to reading the FAT */
+		vfree(sbi->free_map);
+		sbi->free_map = NULL;
+		return err;
+	}
+
+	sbi->free_map_scanned = fatent.entry;
+	if (fat_free_map_valid(sbi)) {
+		free = sbi->max_cluster - bitmap_weight(sbi->free_map,
+							sbi->max_cluster);
+		if (sbi->free_clusters != free || !sbi->free_clus_valid) {
+			sbi->free_clusters = free;
+			sbi->free_clus_valid = 1;
+			sb->s_dirt = 1;
+		}
+	}
+	return 0;
+}
+
+static void fat_free_map_work(struct work_struct *work)
+{
+	struct msdos_sb_info *sbi;
+	struct super_block *sb;
+
+	sbi = container_of(work, struct msdos_sb_info, free_map_work);
+	sb = sbi->fat_inode->i_sb;
+
+	/* one chunk at a time, so that allocations are not held up */
+	lock_fat(sbi);
+	if (sbi->free_map && !fat_free_map_valid(sbi) &&
+	    !fat_free_map_scan(sb) && !fat_free_map_valid(sbi))
+		queue_work(fat_free_map_wq, &sbi->free_map_work);
+	unlock_fat(sbi);
+}
+
+/*
+ * Called at the end of mount.  If the map of this filesystem fits in
+ * FAT_FREE_MAP_MAX, allocate it and start filling it in the background.
+ * Otherwise allocation and statfs() keep reading the FAT.
+ */
+void fat_free_map_start(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	unsigned long size = BITS_TO_LONGS(sbi->max_cluster) * sizeof(long);
+
+	INIT_WORK(&sbi->free_map_work, fat_free_map_work);
+	if (size > FAT_FREE_MAP_MAX)
+		return;
+
+	sbi->free_map = vmalloc(size);
+	if (!sbi->free_map)
+		return;
+	memset(sbi->free_map, 0, size);
+	/* the first two entries are reserved */
+	__set_bit(0, sbi->free_map);
+	__set_bit(1, sbi->free_map);
+	sbi->free_map_scanned = FAT_START_ENT;
+
+	queue_work(fat_free_map_wq, &sbi->free_map_work);
+}
+
+void fat_free_map_stop(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+
+	cancel_work_sync(&sbi->free_map_work);
+	vfree(sbi->free_map);
+	sbi->free_map = NULL;
+}
+
+int __init fat_free_map_init(void)
+{
+	fat_free_map_wq = create_singlethread_workqueue("fat_free_map");
+	if (!fat_free_map_wq)
+		return -ENOMEM;
+	return 0;
+}
+
+void fat_free_map_destroy(void)
+{
+	destroy_workqueue(fat_free_map_wq);
+}
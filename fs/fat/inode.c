@@ -492,6 +492,8 @@ static void fat_put_super(struct super_block *sb)
 
 	lock_kernel();
 
+	fat_free_map_stop(sb);
+
 	if (sb->s_dirt)
 		fat_write_super(sb);
 
@@ -1518,6 +1520,8 @@ int fat_fill_super(struct super_block *sb, void *data, int silent,
 		goto out_fail;
 	}
 
+	fat_free_map_start(sb);
+
 	return 0;
 
 out_invalid:
@@ -1600,12 +1604,18 @@ static int __init init_fat_fs(void)
 	if (err)
 		return err;
 
-	err = fat_init_inodecache();
+	err = fat_free_map_init();
 	if (err)
 		goto failed;
 
+	err = fat_init_inodecache();
+	if (err)
+		goto failed_free_map;
+
 	return 0;
 
+failed_free_map:
+	fat_free_map_destroy();
 failed:
 	fat_cache_destroy();
 	return err;
@@ -1613,6 +1623,7 @@ failed:
 
 static void __exit exit_fat_fs(void)
 {
+	fat_free_map_destroy();
 	fat_cache_destroy();
 	fat_destroy_inodecache();
 }
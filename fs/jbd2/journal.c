@@ -81,6 +81,7 @@ EXPORT_SYMBOL(jbd2_journal_ack_err);
 EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
 EXPORT_SYMBOL(jbd2_log_start_commit);
+EXPORT_SYMBOL(jbd2_log_start_commit_batched);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
 EXPORT_SYMBOL(jbd2_journal_wipe);
@@ -493,6 +494,76 @@ int jbd2_log_start_commit(journal_t *journal, tid_t tid)
 	return ret;
 }
 
+/*
+ * Let a transaction which started at @start_time run until it is about as
+ * old as a commit takes, so that other synchronous callers can join it
+ * before it is committed.  @commit_time is in nanoseconds and is clamped
+ * to the journal's batch time limits.  Returns true if we slept.
+ */
+int __jbd2_journal_batch_wait(journal_t *journal, ktime_t start_time,
+			      u64 commit_time)
+{
+	u64 trans_time;
+	ktime_t expires;
+
+	commit_time = max_t(u64, commit_time, 1000*journal->j_min_batch_time);
+	commit_time = min_t(u64, commit_time, 1000*journal->j_max_batch_time);
+
+	trans_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
+	if (trans_time >= commit_time)
+		return 0;
+
+	expires = ktime_add_ns(ktime_get(), commit_time - trans_time);
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+	return 1;
+}
+
+/*
+ * jbd2_log_start_commit_batched() is jbd2_log_start_commit() for fsync().
+ *
+ * Database engines call fsync() after every small transaction, often
+ * from several threads at once.  Each call would commit the running
+ * transaction on its own, so the journal ends up writing a commit for
+ * every fsync().  When the previous synchronous caller was another task,
+ * give the transaction the same chance to collect more callers that
+ * jbd2_journal_stop() gives synchronous handles: let it run for about
+ * as long as the last commits took before committing it.
+ */
+int jbd2_log_start_commit_batched(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	pid_t pid = current->pid;
+	ktime_t start_time = ktime_set(0, 0);
+	u64 commit_time = 0;
+	int batch = 0, ret;
+
+	spin_lock(&journal->j_state_lock);
+	transaction = journal->j_running_transaction;
+	if (transaction && transaction->t_tid == tid &&
+	    !tid_geq(journal->j_commit_request, tid) &&
+	    journal->j_last_sync_writer != pid) {
+		start_time = transaction->t_start_time;
+		commit_time = journal->j_average_commit_time;
+		batch = 1;
+	}
+	journal->j_last_sync_writer = pid;
+	spin_unlock(&journal->j_state_lock);
+
+	if (batch)
+		batch = __jbd2_journal_batch_wait(journal, start_time,
+						  commit_time);
+
+	spin_lock(&journal->j_state_lock);
+	ret = __jbd2_log_start_commit(journal, tid);
+	if (ret)
+		journal->j_fsync_commits++;
+	if (batch)
+		journal->j_fsync_waits++;
+	spin_unlock(&journal->j_state_lock);
+	return ret;
+}
+
 /*
  * Force and wait upon a commit if the calling process is not within
  * transaction.  This is used for forcing out undo-protected data which contains
@@ -722,6 +793,10 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "fsync: \n  %lu commits started\n",
+		   s->journal->j_fsync_commits);
+	seq_printf(seq, "  %lu waits for other callers\n",
+		   s->journal->j_fsync_waits);
 	return 0;
 }
 
@@ -1287,7 +1287,7 @@ int jbd2_journal_stop(handle_t *handle)
 	 */
 	pid = current->pid;
 	if (handle->h_sync && journal->j_last_sync_writer != pid) {
-		u64 commit_time, trans_time;
+		u64 commit_time;
 
 		journal->j_last_sync_writer = pid;
 
@@ -1295,20 +1295,8 @@ int jbd2_journal_stop(handle_t *handle)
 		commit_time = journal->j_average_commit_time;
 		spin_unlock(&journal->j_state_lock);
 
-		trans_time = ktime_to_ns(ktime_sub(ktime_get(),
-						   transaction->t_start_time));
-
-		commit_time = max_t(u64, commit_time,
-				    1000*journal->j_min_batch_time);
-		commit_time = min_t(u64, commit_time,
-				    1000*journal->j_max_batch_time);
-
-		if (trans_time < commit_time) {
-			ktime_t expires = ktime_add_ns(ktime_get(),
-						       commit_time);
-			set_current_state(TASK_UNINTERRUPTIBLE);
-			schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
-		}
+		__jbd2_journal_batch_wait(journal, transaction->t_start_time,
+					  commit_time);
 	}
 
 	if (handle->h_sync)
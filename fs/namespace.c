@@ -29,6 +29,7 @@
 #include <linux/log2.h>
 #include <linux/idr.h>
 #include <linux/fs_struct.h>
+#include <linux/boot_timeline.h>
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
 #include "pnode.h"
@@ -1997,9 +1998,12 @@ long do_mount(char *dev_name, char *dir_name, char *type_page,
 		retval = do_change_type(&path, flags);
 	else if (flags & MS_MOVE)
 		retval = do_move_mount(&path, dev_name);
-	else
+	else {
+		boot_timeline_begin(BOOT_TL_MOUNT, NULL, dir_name);
 		retval = do_new_mount(&path, type_page, flags, mnt_flags,
 				      dev_name, data_page);
+		boot_timeline_end(BOOT_TL_MOUNT, NULL, dir_name);
+	}
 dput_out:
 	path_put(&path);
 	return retval;
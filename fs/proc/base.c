@@ -361,10 +361,24 @@ static int proc_pid_stack(struct seq_file *m, struct pid_namespace *ns,
  */
 static int proc_pid_schedstat(struct task_struct *task, char *buffer)
 {
-	return sprintf(buffer, "%llu %llu %lu\n",
+	struct sched_lat_hist *hist = &task->sched_info.lat_hist;
+	int i, len;
+
+	len = sprintf(buffer, "%llu %llu %lu\n",
 			(unsigned long long)task->se.sum_exec_runtime,
 			(unsigned long long)task->sched_info.run_delay,
 			task->sched_info.pcount);
+
+	/* wait latency histograms, see kernel.sched_latency_hist */
+	len += sprintf(buffer + len, "wakeup");
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		len += sprintf(buffer + len, " %u", hist->wakeup[i]);
+	len += sprintf(buffer + len, "\npreempt");
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		len += sprintf(buffer + len, " %u", hist->preempt[i]);
+	len += sprintf(buffer + len, "\n");
+
+	return len;
 }
 #endif
 
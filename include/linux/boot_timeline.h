@@ -0,0 +1,43 @@
+#ifndef _LINUX_BOOT_TIMELINE_H
+#define _LINUX_BOOT_TIMELINE_H
+
+/*
+ * Boot timeline: begin and end timestamps of the things boot time is
+ * spent on, exported in debugfs as boot_timeline.
+ */
+
+enum boot_timeline_type {
+	BOOT_TL_INITCALL,
+	BOOT_TL_PROBE,
+	BOOT_TL_ASYNC,
+	BOOT_TL_FIRMWARE,
+	BOOT_TL_MOUNT,
+	BOOT_TL_INIT,
+};
+
+#define BOOT_TL_BEGIN	'B'
+#define BOOT_TL_END	'E'
+#define BOOT_TL_MARK	'M'
+
+#ifdef CONFIG_BOOT_TIMELINE
+extern void boot_timeline_event(int type, char phase, void *fn,
+				const char *name);
+#else
+static inline void boot_timeline_event(int type, char phase, void *fn,
+				       const char *name)
+{
+}
+#endif
+
+/*
+ * Events are identified either by a function, printed symbolically,
+ * or by a name; the name is copied.
+ */
+#define boot_timeline_begin(type, fn, name)	\
+	boot_timeline_event(type, BOOT_TL_BEGIN, fn, name)
+#define boot_timeline_end(type, fn, name)	\
+	boot_timeline_event(type, BOOT_TL_END, fn, name)
+#define boot_timeline_mark(type, fn, name)	\
+	boot_timeline_event(type, BOOT_TL_MARK, fn, name)
+
+#endif /* _LINUX_BOOT_TIMELINE_H */
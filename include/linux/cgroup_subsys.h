@@ -55,6 +55,12 @@ SUBSYS(freezer)
 
 /* */
 
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+SUBSYS(timer_slack)
+#endif
+
+/* */
+
 #ifdef CONFIG_NET_CLS_CGROUP
 SUBSYS(net_cls)
 #endif
@@ -39,12 +39,14 @@ struct cgroupstats {
 
 /*
  * Commands sent from userspace
- * Not versioned. New commands should only be inserted at the enum's end
- * prior to __CGROUPSTATS_CMD_MAX
+ * Not versioned. These share the taskstats family and their numbers are
+ * ABI: CGROUPSTATS_CMD_UNSPEC must stay 3 whatever taskstats.h adds, and
+ * new commands should only be inserted at the enum's end prior to
+ * __CGROUPSTATS_CMD_MAX (which TASKSTATS_CMD_DUMP follows)
  */
 
 enum {
-	CGROUPSTATS_CMD_UNSPEC = __TASKSTATS_CMD_MAX,	/* Reserved */
+	CGROUPSTATS_CMD_UNSPEC = 3,	/* Reserved */
 	CGROUPSTATS_CMD_GET,		/* user->kernel request/get-response */
 	CGROUPSTATS_CMD_NEW,		/* kernel->user event */
 	__CGROUPSTATS_CMD_MAX,
@@ -127,6 +127,8 @@ struct device_driver {
 	const char		*mod_name;	/* used for built-in modules */
 
 	bool suppress_bind_attrs;	/* disables bind/unbind via sysfs */
+	bool probe_async;		/* probe devices asynchronously at boot */
+	struct list_head *probe_domain;	/* async probes ordered against */
 
 #if defined(CONFIG_OF)
 	const struct of_device_id	*of_match_table;
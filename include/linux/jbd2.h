@@ -734,6 +734,8 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_wbufsize: maximum number of buffer_heads allowed in j_wbuf, the
  *	number that will fit in j_blocksize
  * @j_last_sync_writer: most recent pid which did a synchronous write
+ * @j_fsync_commits: commits started by jbd2_log_start_commit_batched()
+ * @j_fsync_waits: times jbd2_log_start_commit_batched() waited for joiners
  * @j_history: Buffer storing the transactions statistics history
  * @j_history_max: Maximum number of transactions in the statistics history
  * @j_history_cur: Current number of transactions in the statistics history
@@ -958,6 +960,12 @@ struct journal_s
 	u32			j_min_batch_time;
 	u32			j_max_batch_time;
 
+	/*
+	 * fsync() batching statistics [j_state_lock]
+	 */
+	unsigned long		j_fsync_commits;
+	unsigned long		j_fsync_waits;
+
 	/* This function is called when a transaction is closed */
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
@@ -1184,6 +1192,9 @@ extern void	jbd2_journal_switch_revoke_table(journal_t *journal);
 int __jbd2_log_space_left(journal_t *); /* Called with journal locked */
 int jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
+int jbd2_log_start_commit_batched(journal_t *journal, tid_t tid);
+int __jbd2_journal_batch_wait(journal_t *journal, ktime_t start_time,
+			      u64 commit_time);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
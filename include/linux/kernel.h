@@ -259,6 +259,10 @@ extern bool printk_timed_ratelimit(unsigned long *caller_jiffies,
 				   unsigned int interval_msec);
 
 extern int printk_delay_msec;
+extern int printk_deferred;
+extern unsigned long printk_console_dropped;
+extern unsigned long printk_console_backlog;
+extern unsigned long printk_console_backlog_max;
 
 /*
  * Print a one-time message (analogous to WARN_ONCE() et al):
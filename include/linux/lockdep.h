@@ -402,9 +402,43 @@ do {								\
 #define lock_contended(lockdep_map, ip) do {} while (0)
 #define lock_acquired(lockdep_map, ip) do {} while (0)
 
+#ifdef CONFIG_LOCK_CONTENTION_PROF
+
+#include <linux/types.h>
+
+/*
+ * The contention profiler only looks at acquisitions which have to
+ * wait: it records the time from lock_prof_start() until the lock is
+ * taken, keyed by the locking function and its caller.  See
+ * kernel/lock_prof.c.
+ */
+extern u64 lock_prof_start(void);
+extern void lock_prof_acquired(void *lock, unsigned long op,
+			       unsigned long ip, u64 start);
+
+#define LOCK_CONTENDED(_lock, try, lock)				\
+do {									\
+	if (!try(_lock)) {						\
+		u64 __start = lock_prof_start();			\
+		lock(_lock);						\
+		lock_prof_acquired(_lock, _THIS_IP_, _RET_IP_, __start); \
+	}								\
+} while (0)
+
+#else /* CONFIG_LOCK_CONTENTION_PROF */
+
+static inline u64 lock_prof_start(void)
+{
+	return 0;
+}
+
+#define lock_prof_acquired(lock, op, ip, start) do { (void)(start); } while (0)
+
 #define LOCK_CONTENDED(_lock, try, lock) \
 	lock(_lock)
 
+#endif /* CONFIG_LOCK_CONTENTION_PROF */
+
 #endif /* CONFIG_LOCK_STAT */
 
 #ifdef CONFIG_LOCKDEP
@@ -417,6 +451,17 @@ do {								\
 #define LOCK_CONTENDED_FLAGS(_lock, try, lock, lockfl, flags) \
 	LOCK_CONTENDED((_lock), (try), (lock))
 
+#elif defined(CONFIG_LOCK_CONTENTION_PROF)
+
+#define LOCK_CONTENDED_FLAGS(_lock, try, lock, lockfl, flags)		\
+do {									\
+	if (!try(_lock)) {						\
+		u64 __start = lock_prof_start();			\
+		lockfl((_lock), (flags));				\
+		lock_prof_acquired(_lock, _THIS_IP_, _RET_IP_, __start); \
+	}								\
+} while (0)
+
 #else /* CONFIG_LOCKDEP */
 
 #define LOCK_CONTENDED_FLAGS(_lock, try, lock, lockfl, flags) \
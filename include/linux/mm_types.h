@@ -183,6 +183,10 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_SWAP
+	/* Last fault address, window and hits of VMA based swap readahead */
+	atomic_long_t swap_readahead_info;
+#endif
 };
 
 struct core_thread {
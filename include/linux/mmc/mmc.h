@@ -131,6 +131,9 @@
 #define R1_SWITCH_ERROR		(1 << 7)	/* sx, c */
 #define R1_APP_CMD		(1 << 5)	/* sr, c */
 
+#define R1_STATE_TRAN	4	/* R1_CURRENT_STATE values */
+#define R1_STATE_PRG	7
+
 /*
  * MMC/SD in SPI mode reports R1 status always, and R2 for SEND_STATUS
  * R1 is the low order byte; R2 is the next highest byte, when present.
@@ -251,14 +254,33 @@ struct _mmc_csd {
  * EXT_CSD fields
  */
 
+#define EXT_CSD_FLUSH_CACHE		32	/* W */
+#define EXT_CSD_CACHE_CTRL		33	/* R/W */
+#define EXT_CSD_HPI_MGMT		161	/* R/W */
+#define EXT_CSD_BKOPS_EN		163	/* R/W */
+#define EXT_CSD_BKOPS_START		164	/* W */
+#define EXT_CSD_ERASE_GROUP_DEF		175	/* R/W */
+#define EXT_CSD_ERASED_MEM_CONT		181	/* RO */
 #define EXT_CSD_BUS_WIDTH	183	/* R/W */
 #define EXT_CSD_HS_TIMING	185	/* R/W */
 #define EXT_CSD_CARD_TYPE	196	/* RO */
+#define EXT_CSD_OUT_OF_INTERRUPT_TIME	198	/* RO */
 #define EXT_CSD_STRUCTURE	194	/* RO */
 #define EXT_CSD_REV		192	/* RO */
 #define EXT_CSD_SEC_CNT		212	/* RO, 4 bytes */
 #define EXT_CSD_S_A_TIMEOUT	217
+#define EXT_CSD_ERASE_TIMEOUT_MULT	223	/* RO */
+#define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_SIZE_MULTI	226
+#define EXT_CSD_SEC_TRIM_MULT		229	/* RO */
+#define EXT_CSD_SEC_ERASE_MULT		230	/* RO */
+#define EXT_CSD_SEC_FEATURE_SUPPORT	231	/* RO */
+#define EXT_CSD_TRIM_MULT		232	/* RO */
+#define EXT_CSD_BKOPS_STATUS		246	/* RO */
+#define EXT_CSD_GENERIC_CMD6_TIME	248	/* RO */
+#define EXT_CSD_CACHE_SIZE		249	/* RO, 4 bytes */
+#define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
+#define EXT_CSD_HPI_FEATURES		503	/* RO */
 /*
  * EXT_CSD field definitions
  */
@@ -283,6 +305,19 @@ struct _mmc_csd {
 #define EXT_CSD_DDR_BUS_WIDTH_4	5	/* Card is in 4 bit DDR mode */
 #define EXT_CSD_DDR_BUS_WIDTH_8	6	/* Card is in 8 bit DDR mode */
 
+#define EXT_CSD_SEC_ER_EN	(1<<0)	/* Secure erase/trim supported */
+#define EXT_CSD_SEC_BD_BLK_EN	(1<<2)	/* Secure bad block management */
+#define EXT_CSD_SEC_GB_CL_EN	(1<<4)	/* Trim supported */
+
+#define EXT_CSD_HPI_SUPPORT	(1<<0)	/* High priority interrupt */
+#define EXT_CSD_HPI_IMPL_CMD12	(1<<1)	/* HPI is CMD12, not CMD13 */
+
+#define EXT_CSD_BKOPS_LEVEL_MASK	0x3	/* BKOPS_STATUS levels: */
+#define EXT_CSD_BKOPS_LEVEL_NONE	0	/* not required */
+#define EXT_CSD_BKOPS_LEVEL_1		1	/* outstanding */
+#define EXT_CSD_BKOPS_LEVEL_2		2	/* performance impacted */
+#define EXT_CSD_BKOPS_LEVEL_3		3	/* critical */
+
 /*
  * MMC_SWITCH access modes
  */
@@ -166,6 +166,13 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Orders 1..PCP_HIGH_ORDER are also cached on the per-cpu lists, so that
+ * task stacks, skb heads and slabs of larger objects mostly avoid the
+ * zone lock as well.
+ */
+#define PCP_HIGH_ORDER		PAGE_ALLOC_COSTLY_ORDER
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
@@ -173,6 +180,11 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* Base pages held in high_lists, bounded by 2 * batch */
+	int high_count;
+	/* Free blocks of order 1..PCP_HIGH_ORDER, per migrate type */
+	struct list_head high_lists[PCP_HIGH_ORDER][MIGRATE_PCPTYPES];
 };
 
 struct per_cpu_pageset {
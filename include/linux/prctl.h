@@ -102,4 +102,22 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Get/set the latency boost hint of a thread: a boosted thread preempts
+ * the running task more readily when it wakes up, without getting a
+ * larger share of the cpu.
+ *
+ *   prctl(PR_SET_LATENCY_BOOST, boost, pid)
+ *   prctl(PR_GET_LATENCY_BOOST, pid)
+ *
+ * pid 0 is the calling thread.  Setting the hint of another thread
+ * requires CAP_SYS_NICE or the right to ptrace it.
+ *
+ * These are local options, so they live in a range of their own
+ * ("LB" << 16), well clear of the numbers upstream hands out, to
+ * keep them from colliding with later upstream options.
+ */
+#define PR_SET_LATENCY_BOOST 0x4c420001
+#define PR_GET_LATENCY_BOOST 0x4c420002
+
 #endif /* _LINUX_PRCTL_H */
@@ -706,6 +706,20 @@ extern struct user_struct root_user;
 struct backing_dev_info;
 struct reclaim_state;
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * log2 histograms of how long a runnable task waited for the cpu: bucket 0
+ * counts waits below 1024ns, bucket i (i > 0) waits of [2^(i-1), 2^i)
+ * 1024ns units and the last bucket everything longer.
+ */
+#define SCHED_LAT_HIST_BUCKETS	20
+
+struct sched_lat_hist {
+	unsigned int wakeup[SCHED_LAT_HIST_BUCKETS];	/* after a wakeup */
+	unsigned int preempt[SCHED_LAT_HIST_BUCKETS];	/* after preemption */
+};
+#endif
+
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 struct sched_info {
 	/* cumulative counters */
@@ -718,6 +732,11 @@ struct sched_info {
 #ifdef CONFIG_SCHEDSTATS
 	/* BKL stats */
 	unsigned int bkl_count;
+
+	/* wait latency histograms, see sysctl_sched_latency_hist */
+	unsigned long long lat_pending;	/* wait carried over migrations */
+	int lat_preempted;		/* queued by preemption, not wakeup */
+	struct sched_lat_hist lat_hist;
 #endif
 };
 #endif /* defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT) */
@@ -1205,6 +1224,7 @@ struct task_struct {
 #endif
 
 	unsigned int policy;
+	unsigned int latency_boost;	/* PR_SET_LATENCY_BOOST hint */
 	cpumask_t cpus_allowed;
 
 #ifdef CONFIG_TREE_PREEMPT_RCU
@@ -1695,6 +1715,7 @@ extern int task_free_unregister(struct notifier_block *n);
 #define PF_EXITING	0x00000004	/* getting shut down */
 #define PF_EXITPIDONE	0x00000008	/* pi exit done on shut down */
 #define PF_VCPU		0x00000010	/* I'm a virtual CPU */
+#define PF_WQ_WORKER	0x00000020	/* I'm a workqueue worker */
 #define PF_FORKNOEXEC	0x00000040	/* forked but didn't exec */
 #define PF_MCE_PROCESS  0x00000080      /* process policy on mce errors */
 #define PF_SUPERPRIV	0x00000100	/* used super-user privileges */
@@ -1902,6 +1923,14 @@ int sched_rt_handler(struct ctl_table *table, int write,
 
 extern unsigned int sysctl_sched_compat_yield;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+extern unsigned int sysctl_sched_cfs_bandwidth_slice;
+#endif
+
+#ifdef CONFIG_SCHEDSTATS
+extern unsigned int sysctl_sched_latency_hist;
+#endif
+
 #ifdef CONFIG_RT_MUTEXES
 extern int rt_mutex_getprio(struct task_struct *p);
 extern void rt_mutex_setprio(struct task_struct *p, int prio);
@@ -81,7 +81,17 @@ struct kmem_cache {
 	const char *name;
 	struct list_head next;
 
-/* 6) statistics */
+/* 6) cpucache auto-tuning, protected by cache_chain_mutex */
+	unsigned int user_tuned;	/* limits set via /proc/slabinfo */
+	unsigned long next_adapt;	/* jiffies of the next resize check */
+	unsigned long adapt_churn;	/* refills + flushes at last check */
+	unsigned long adapt_allochit;	/* allochit at last check */
+	/* fast path counters of cpucaches already freed by a resize */
+	unsigned long cpu_allochit;
+	unsigned long cpu_refill;
+	unsigned long cpu_flush;
+
+/* 7) statistics */
 #ifdef CONFIG_DEBUG_SLAB
 	unsigned long num_active;
 	unsigned long num_allocations;
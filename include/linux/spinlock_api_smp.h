@@ -111,13 +111,11 @@ static inline unsigned long __raw_spin_lock_irqsave(raw_spinlock_t *lock)
 	/*
 	 * On lockdep we dont want the hand-coded irq-enable of
 	 * do_raw_spin_lock_flags() code, because lockdep assumes
-	 * that interrupts are not re-enabled during lock-acquire:
+	 * that interrupts are not re-enabled during lock-acquire;
+	 * LOCK_CONTENDED_FLAGS() takes care of that:
 	 */
-#ifdef CONFIG_LOCKDEP
-	LOCK_CONTENDED(lock, do_raw_spin_trylock, do_raw_spin_lock);
-#else
-	do_raw_spin_lock_flags(lock, &flags);
-#endif
+	LOCK_CONTENDED_FLAGS(lock, do_raw_spin_trylock, do_raw_spin_lock,
+			     do_raw_spin_lock_flags, &flags);
 	return flags;
 }
 
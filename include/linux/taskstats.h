@@ -166,10 +166,41 @@ struct taskstats {
 };
 
 
+/*
+ * Compact per-task record returned by TASKSTATS_CMD_DUMP
+ *
+ * A dump streams one TASKSTATS_TYPE_SNAP attribute per task, packed
+ * several to a netlink message, so that a monitor can sample every
+ * task in the system without walking /proc.
+ *
+ * Like struct taskstats, this struct is versioned: new fields must only
+ * be appended, TASKSTATS_SNAP_VERSION bumped, and 64-bit alignment kept.
+ * Consumers should use ts_size to step over records of newer versions.
+ */
+
+#define TASKSTATS_SNAP_VERSION	1
+
+struct taskstats_snap {
+	__u16	ts_version;		/* TASKSTATS_SNAP_VERSION */
+	__u16	ts_size;		/* sizeof(struct taskstats_snap) */
+	__u32	ts_pid;			/* Process id */
+	__u32	ts_tgid;		/* Thread group id */
+	__u32	ts_state;		/* state | exit_state, see TASK_REPORT */
+	__s32	ts_oom_adj;		/* signal->oom_adj */
+	__u32	ts_cpu;			/* CPU the task last ran on */
+	__u64	ts_utime;		/* User CPU time [usec] */
+	__u64	ts_stime;		/* System CPU time [usec] */
+	__u64	ts_rss;			/* Resident set size [pages] */
+	/* Version 1 ends here */
+};
+
+
 /*
  * Commands sent from userspace
- * Not versioned. New commands should only be inserted at the enum's end
- * prior to __TASKSTATS_CMD_MAX
+ * Not versioned. The CGROUPSTATS_CMD_* commands of the same family are
+ * numbered from __TASKSTATS_CMD_MAX on, so no command may be inserted
+ * here without changing theirs: new commands take numbers after
+ * __CGROUPSTATS_CMD_MAX, see TASKSTATS_CMD_DUMP.
  */
 
 enum {
@@ -181,6 +212,10 @@ enum {
 
 #define TASKSTATS_CMD_MAX (__TASKSTATS_CMD_MAX - 1)
 
+enum {
+	TASKSTATS_CMD_DUMP = 6,		/* user->kernel dump of all tasks */
+};
+
 enum {
 	TASKSTATS_TYPE_UNSPEC = 0,	/* Reserved */
 	TASKSTATS_TYPE_PID,		/* Process id */
@@ -188,6 +223,7 @@ enum {
 	TASKSTATS_TYPE_STATS,		/* taskstats structure */
 	TASKSTATS_TYPE_AGGR_PID,	/* contains pid + stats */
 	TASKSTATS_TYPE_AGGR_TGID,	/* contains tgid + stats */
+	TASKSTATS_TYPE_SNAP,		/* taskstats_snap structure */
 	__TASKSTATS_TYPE_MAX,
 };
 
@@ -26,7 +26,12 @@ struct work_struct {
 	atomic_long_t data;
 #define WORK_STRUCT_PENDING 0		/* T if work item pending execution */
 #define WORK_STRUCT_STATIC  1		/* static initializer (debugobjects) */
-#define WORK_STRUCT_FLAG_MASK (3UL)
+#define WORK_STRUCT_DELAYED 2		/* waiting for max_active, not queued */
+#define WORK_STRUCT_LINKED  3		/* next work is linked to this one */
+#define WORK_STRUCT_COLOR_SHIFT 4	/* flush color, see flush_workqueue() */
+#define WORK_STRUCT_COLOR_BITS  2
+#define WORK_STRUCT_FLAG_BITS (WORK_STRUCT_COLOR_SHIFT + WORK_STRUCT_COLOR_BITS)
+#define WORK_STRUCT_FLAG_MASK ((1UL << WORK_STRUCT_FLAG_BITS) - 1)
 #define WORK_STRUCT_WQ_DATA_MASK (~WORK_STRUCT_FLAG_MASK)
 	struct list_head entry;
 	work_func_t func;
@@ -180,13 +185,26 @@ static inline void destroy_work_on_stack(struct work_struct *work) { }
 	clear_bit(WORK_STRUCT_PENDING, work_data_bits(work))
 
 
+/*
+ * Workqueue flags and constants.  For details, please refer to
+ * Documentation/workqueue.txt.
+ */
+enum {
+	WQ_FREEZEABLE		= 1 << 0, /* freeze during suspend */
+	WQ_SINGLE_CPU		= 1 << 1, /* only the first possible cpu */
+	WQ_RESCUER		= 1 << 2, /* has a rescue worker */
+	WQ_RT			= 1 << 3, /* served by SCHED_FIFO workers */
+
+	WQ_MAX_ACTIVE		= 512,	  /* max in-flight works per cpu */
+	WQ_DFL_ACTIVE		= WQ_MAX_ACTIVE / 2,
+};
+
 extern struct workqueue_struct *
-__create_workqueue_key(const char *name, int singlethread,
-		       int freezeable, int rt, struct lock_class_key *key,
-		       const char *lock_name);
+__alloc_workqueue_key(const char *name, unsigned int flags, int max_active,
+		      struct lock_class_key *key, const char *lock_name);
 
 #ifdef CONFIG_LOCKDEP
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
+#define alloc_workqueue(name, flags, max_active)		\
 ({								\
 	static struct lock_class_key __key;			\
 	const char *__lock_name;				\
@@ -196,16 +214,27 @@ __create_workqueue_key(const char *name, int singlethread,
 	else							\
 		__lock_name = #name;				\
 								\
-	__create_workqueue_key((name), (singlethread),		\
-			       (freezeable), (rt), &__key,	\
-			       __lock_name);			\
+	__alloc_workqueue_key((name), (flags), (max_active),	\
+			      &__key, __lock_name);		\
 })
 #else
-#define __create_workqueue(name, singlethread, freezeable, rt)	\
-	__create_workqueue_key((name), (singlethread), (freezeable), (rt), \
-			       NULL, NULL)
+#define alloc_workqueue(name, flags, max_active)		\
+	__alloc_workqueue_key((name), (flags), (max_active), NULL, NULL)
 #endif
 
+/*
+ * The traditional interfaces.  Singlethread workqueues still execute one
+ * work at a time, the others get the default max_active.  None of them
+ * has a rescuer: workqueues which the memory reclaim path may wait on
+ * must be created with alloc_workqueue() and WQ_RESCUER.
+ */
+#define __create_workqueue(name, singlethread, freezeable, rt)	\
+	alloc_workqueue((name),					\
+			((singlethread) ? WQ_SINGLE_CPU : 0) |	\
+			((freezeable) ? WQ_FREEZEABLE : 0) |	\
+			((rt) ? WQ_RT : 0),			\
+			(singlethread) ? 1 : 0)
+
 #define create_workqueue(name) __create_workqueue((name), 0, 0, 0)
 #define create_rt_workqueue(name) __create_workqueue((name), 0, 0, 1)
 #define create_freezeable_workqueue(name) __create_workqueue((name), 1, 1, 0)
@@ -297,4 +326,10 @@ static inline long work_on_cpu(unsigned int cpu, long (*fn)(void *), void *arg)
 #else
 long work_on_cpu(unsigned int cpu, long (*fn)(void *), void *arg);
 #endif /* CONFIG_SMP */
+
+#ifdef CONFIG_FREEZER
+extern void freeze_workqueues_begin(void);
+extern bool freeze_workqueues_busy(void);
+extern void thaw_workqueues(void);
+#endif /* CONFIG_FREEZER */
 #endif
@@ -70,6 +70,7 @@
 #include <linux/sfi.h>
 #include <linux/shmem_fs.h>
 #include <linux/slab.h>
+#include <linux/boot_timeline.h>
 #include <trace/boot.h>
 
 #include <asm/io.h>
@@ -752,6 +753,8 @@ int do_one_initcall(initcall_t fn)
 	int count = preempt_count();
 	ktime_t calltime, delta, rettime;
 
+	boot_timeline_begin(BOOT_TL_INITCALL, fn, NULL);
+
 	if (initcall_debug) {
 		call.caller = task_pid_nr(current);
 		printk("calling  %pF @ %i\n", fn, call.caller);
@@ -772,6 +775,8 @@ int do_one_initcall(initcall_t fn)
 			ret.result, ret.duration);
 	}
 
+	boot_timeline_end(BOOT_TL_INITCALL, fn, NULL);
+
 	msgbuf[0] = 0;
 
 	if (ret.result && ret.result != -ENODEV && initcall_debug)
@@ -835,6 +840,7 @@ static void __init do_pre_smp_initcalls(void)
 
 static void run_init_process(char *init_filename)
 {
+	boot_timeline_mark(BOOT_TL_INIT, NULL, init_filename);
 	argv_init[0] = init_filename;
 	kernel_execve(init_filename, argv_init, envp_init);
 }
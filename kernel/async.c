@@ -57,6 +57,7 @@ asynchronous and synchronous parts of the kernel.
 #include <linux/kthread.h>
 #include <linux/delay.h>
 #include <linux/slab.h>
+#include <linux/boot_timeline.h>
 #include <asm/atomic.h>
 
 static async_cookie_t next_cookie = 1;
@@ -66,12 +67,14 @@ static async_cookie_t next_cookie = 1;
 
 static LIST_HEAD(async_pending);
 static LIST_HEAD(async_running);
+static LIST_HEAD(async_all);		/* all entries of all domains */
 static DEFINE_SPINLOCK(async_lock);
 
 static int async_enabled = 0;
 
 struct async_entry {
 	struct list_head list;
+	struct list_head all_list;	/* on async_all, in cookie order */
 	async_cookie_t   cookie;
 	async_func_ptr	 *func;
 	void             *data;
@@ -89,11 +92,21 @@ extern int initcall_debug;
 
 /*
  * MUST be called with the lock held!
+ *
+ * A NULL @running stands for all domains.
  */
 static async_cookie_t  __lowest_in_progress(struct list_head *running)
 {
 	struct async_entry *entry;
 
+	if (!running) {
+		if (list_empty(&async_all))
+			return next_cookie;
+		entry = list_first_entry(&async_all,
+			struct async_entry, all_list);
+		return entry->cookie;
+	}
+
 	if (!list_empty(running)) {
 		entry = list_first_entry(running,
 			struct async_entry, list);
@@ -143,7 +156,9 @@ static void run_one_entry(void)
 			entry->func, task_pid_nr(current));
 		calltime = ktime_get();
 	}
+	boot_timeline_begin(BOOT_TL_ASYNC, entry->func, NULL);
 	entry->func(entry->data, entry->cookie);
+	boot_timeline_end(BOOT_TL_ASYNC, entry->func, NULL);
 	if (initcall_debug && system_state == SYSTEM_BOOTING) {
 		rettime = ktime_get();
 		delta = ktime_sub(rettime, calltime);
@@ -156,6 +171,7 @@ static void run_one_entry(void)
 	/* 4) remove it from the running queue */
 	spin_lock_irqsave(&async_lock, flags);
 	list_del(&entry->list);
+	list_del(&entry->all_list);
 
 	/* 5) free the entry  */
 	kfree(entry);
@@ -203,6 +219,7 @@ static async_cookie_t __async_schedule(async_func_ptr *ptr, void *data, struct l
 	spin_lock_irqsave(&async_lock, flags);
 	newcookie = entry->cookie = next_cookie++;
 	list_add_tail(&entry->list, &async_pending);
+	list_add_tail(&entry->all_list, &async_all);
 	atomic_inc(&entry_count);
 	spin_unlock_irqrestore(&async_lock, flags);
 	wake_up(&async_new);
@@ -245,13 +262,14 @@ EXPORT_SYMBOL_GPL(async_schedule_domain);
 /**
  * async_synchronize_full - synchronize all asynchronous function calls
  *
- * This function waits until all asynchronous function calls have been done.
+ * This function waits until all asynchronous function calls have been done,
+ * including the ones scheduled in a synchronization domain.
  */
 void async_synchronize_full(void)
 {
 	do {
-		async_synchronize_cookie(next_cookie);
-	} while (!list_empty(&async_running) || !list_empty(&async_pending));
+		async_synchronize_cookie_domain(next_cookie, NULL);
+	} while (!list_empty(&async_all));
 }
 EXPORT_SYMBOL_GPL(async_synchronize_full);
 
@@ -0,0 +1,144 @@
+/*
+ * kernel/boot_timeline.c
+ *
+ * Records when initcalls, device probes, async functions, firmware
+ * requests and mounts begin and end, and when init is started, so
+ * that boot time can be measured past what initcall_debug shows.
+ *
+ * The events are kept in a fixed table which is filled once: events
+ * past its end are only counted, so the beginning of boot is never
+ * overwritten by later hotplug activity.  The table is exported in
+ * debugfs as boot_timeline, one event per line.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/boot_timeline.h>
+
+#define BOOT_TL_NAME_LEN	32
+
+struct boot_timeline_entry {
+	u64		time;		/* cpu_clock() in ns */
+	pid_t		pid;
+	u8		type;
+	char		phase;
+	void		*fn;
+	char		name[BOOT_TL_NAME_LEN];
+};
+
+static struct boot_timeline_entry
+	boot_timeline[CONFIG_BOOT_TIMELINE_ENTRIES];
+static unsigned int boot_timeline_len;
+static unsigned long boot_timeline_dropped;
+static DEFINE_SPINLOCK(boot_timeline_lock);
+
+static const char *boot_timeline_types[] = {
+	[BOOT_TL_INITCALL]	= "initcall",
+	[BOOT_TL_PROBE]		= "probe",
+	[BOOT_TL_ASYNC]		= "async",
+	[BOOT_TL_FIRMWARE]	= "firmware",
+	[BOOT_TL_MOUNT]		= "mount",
+	[BOOT_TL_INIT]		= "init",
+};
+
+void boot_timeline_event(int type, char phase, void *fn, const char *name)
+{
+	struct boot_timeline_entry *e;
+	unsigned long flags;
+
+	spin_lock_irqsave(&boot_timeline_lock, flags);
+	if (boot_timeline_len == ARRAY_SIZE(boot_timeline)) {
+		boot_timeline_dropped++;
+		spin_unlock_irqrestore(&boot_timeline_lock, flags);
+		return;
+	}
+	e = &boot_timeline[boot_timeline_len];
+
+	e->time = cpu_clock(raw_smp_processor_id());
+	e->pid = task_pid_nr(current);
+	e->type = type;
+	e->phase = phase;
+	e->fn = fn;
+	if (name)
+		strlcpy(e->name, name, sizeof(e->name));
+
+	/* publish the entry only once it's complete */
+	smp_wmb();
+	boot_timeline_len++;
+	spin_unlock_irqrestore(&boot_timeline_lock, flags);
+}
+
+static void *boot_timeline_start(struct seq_file *m, loff_t *pos)
+{
+	if (*pos == 0)
+		return SEQ_START_TOKEN;
+	if (*pos > boot_timeline_len)
+		return NULL;
+	smp_rmb();
+	return &boot_timeline[*pos - 1];
+}
+
+static void *boot_timeline_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return boot_timeline_start(m, pos);
+}
+
+static void boot_timeline_stop(struct seq_file *m, void *v)
+{
+}
+
+static int boot_timeline_show(struct seq_file *m, void *v)
+{
+	struct boot_timeline_entry *e = v;
+	unsigned long long usecs;
+
+	if (v == SEQ_START_TOKEN) {
+		seq_printf(m, "# entries: %u dropped: %lu\n",
+			   boot_timeline_len, boot_timeline_dropped);
+		seq_printf(m, "# %12s %6s %5s %-8s %s\n",
+			   "usecs", "pid", "phase", "type", "name");
+		return 0;
+	}
+
+	usecs = e->time;
+	do_div(usecs, NSEC_PER_USEC);
+	seq_printf(m, "%14llu %6d %5c %-8s ", usecs, e->pid, e->phase,
+		   boot_timeline_types[e->type]);
+	if (e->fn)
+		seq_printf(m, "%pF\n", e->fn);
+	else
+		seq_printf(m, "%s\n", e->name);
+	return 0;
+}
+
+static const struct seq_operations boot_timeline_seq_ops = {
+	.start	= boot_timeline_start,
+	.next	= boot_timeline_next,
+	.stop	= boot_timeline_stop,
+	.show	= boot_timeline_show,
+};
+
+static int boot_timeline_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &boot_timeline_seq_ops);
+}
+
+static const struct file_operations boot_timeline_fops = {
+	.open		= boot_timeline_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init boot_timeline_debugfs_init(void)
+{
+	debugfs_create_file("boot_timeline", S_IRUSR, NULL, NULL,
+			    &boot_timeline_fops);
+	return 0;
+}
+fs_initcall(boot_timeline_debugfs_init);
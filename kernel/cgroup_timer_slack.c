@@ -0,0 +1,128 @@
+/*
+ * cgroup_timer_slack.c - control group timer slack subsystem
+ *
+ * Tasks in a timer slack cgroup have their timer slack set to the
+ * value of the group, so that background tasks can be given a large
+ * slack and their timers batched with others, which cuts down the
+ * number of wakeups from idle.  The slack applies to hrtimer based
+ * sleeps and, when it exceeds a jiffy, to timer wheel timers armed by
+ * the tasks.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/cgroup.h>
+#include <linux/init_task.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+struct cgroup_subsys timer_slack_subsys;
+
+struct timer_slack_cgroup {
+	struct cgroup_subsys_state css;
+	unsigned long slack_ns;
+};
+
+static inline struct timer_slack_cgroup *cgroup_tslack(struct cgroup *cgroup)
+{
+	return container_of(cgroup_subsys_state(cgroup, timer_slack_subsys_id),
+			    struct timer_slack_cgroup, css);
+}
+
+static void tslack_apply(struct task_struct *tsk, unsigned long slack_ns)
+{
+	tsk->default_timer_slack_ns = slack_ns;
+	tsk->timer_slack_ns = slack_ns;
+}
+
+static struct cgroup_subsys_state *
+tslack_create(struct cgroup_subsys *ss, struct cgroup *cgroup)
+{
+	struct timer_slack_cgroup *tslack;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	if (cgroup->parent)
+		tslack->slack_ns = cgroup_tslack(cgroup->parent)->slack_ns;
+	else
+		tslack->slack_ns = init_task.timer_slack_ns;
+
+	return &tslack->css;
+}
+
+static void tslack_destroy(struct cgroup_subsys *ss, struct cgroup *cgroup)
+{
+	kfree(cgroup_tslack(cgroup));
+}
+
+static void tslack_attach(struct cgroup_subsys *ss, struct cgroup *cgroup,
+			  struct cgroup *old_cgroup, struct task_struct *tsk,
+			  bool threadgroup)
+{
+	unsigned long slack_ns = cgroup_tslack(cgroup)->slack_ns;
+
+	tslack_apply(tsk, slack_ns);
+	if (threadgroup) {
+		struct task_struct *c;
+
+		rcu_read_lock();
+		list_for_each_entry_rcu(c, &tsk->thread_group, thread_group)
+			tslack_apply(c, slack_ns);
+		rcu_read_unlock();
+	}
+}
+
+static u64 tslack_read_slack(struct cgroup *cgroup, struct cftype *cft)
+{
+	return cgroup_tslack(cgroup)->slack_ns;
+}
+
+static int tslack_write_slack(struct cgroup *cgroup, struct cftype *cft,
+			      u64 val)
+{
+	struct cgroup_iter it;
+	struct task_struct *tsk;
+
+	if (val > ULONG_MAX)
+		return -EINVAL;
+
+	if (!cgroup_lock_live_group(cgroup))
+		return -ENODEV;
+
+	cgroup_tslack(cgroup)->slack_ns = val;
+
+	cgroup_iter_start(cgroup, &it);
+	while ((tsk = cgroup_iter_next(cgroup, &it)))
+		tslack_apply(tsk, val);
+	cgroup_iter_end(cgroup, &it);
+
+	cgroup_unlock();
+	return 0;
+}
+
+static struct cftype files[] = {
+	{
+		.name = "slack_ns",
+		.read_u64 = tslack_read_slack,
+		.write_u64 = tslack_write_slack,
+	},
+};
+
+static int tslack_populate(struct cgroup_subsys *ss, struct cgroup *cgroup)
+{
+	return cgroup_add_files(cgroup, ss, files, ARRAY_SIZE(files));
+}
+
+struct cgroup_subsys timer_slack_subsys = {
+	.name		= "timer_slack",
+	.create		= tslack_create,
+	.destroy	= tslack_destroy,
+	.populate	= tslack_populate,
+	.attach		= tslack_attach,
+	.subsys_id	= timer_slack_subsys_id,
+};
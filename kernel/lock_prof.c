@@ -0,0 +1,233 @@
+/*
+ * kernel/lock_prof.c
+ *
+ * Lock contention profiler.
+ *
+ * Unlike lock_stat, which needs lockdep, this only hooks the slow
+ * paths of mutexes, rw-semaphores and spinlocks: an acquisition which
+ * has to wait records how long it waited, keyed by the locking
+ * function and the code which called it.  Keying on the callsite rather
+ * than the lock address folds the per-object locks (inodes, dentries,
+ * ...) taken at one place into a single record, so the table does not
+ * fill up with them.  Uncontended acquisitions cost nothing extra.
+ *
+ * The records are exported in /proc/lock_contention; writing '0' to
+ * it clears them.  Samples which find the table full are counted and
+ * reported in the header of that file.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/sched.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/irqflags.h>
+#include <linux/spinlock.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <asm/uaccess.h>
+#include <asm/div64.h>
+
+#define LOCK_PROF_HASH_BITS	9
+#define LOCK_PROF_ENTRIES	(1 << LOCK_PROF_HASH_BITS)
+
+/* wait time histogram: < 1us, < 2us, < 4us, ..., >= 16ms */
+#define LOCK_PROF_BUCKETS	16
+
+struct lock_prof_entry {
+	unsigned long	op;		/* locking function */
+	unsigned long	ip;		/* its caller */
+	unsigned long	lock;		/* last lock contended here */
+	unsigned long	count;		/* contended acquisitions */
+	u64		total_ns;
+	u64		max_ns;
+	unsigned int	hist[LOCK_PROF_BUCKETS];
+};
+
+static struct lock_prof_entry lock_prof_table[LOCK_PROF_ENTRIES];
+static unsigned long lock_prof_dropped;
+
+/*
+ * Not a spinlock_t: taking it must not recurse into the profiler.
+ */
+static arch_spinlock_t lock_prof_lock = __ARCH_SPIN_LOCK_UNLOCKED;
+
+u64 lock_prof_start(void)
+{
+	return cpu_clock(raw_smp_processor_id());
+}
+EXPORT_SYMBOL(lock_prof_start);
+
+static unsigned int lock_prof_bucket(u64 wait_ns)
+{
+	u64 usecs = wait_ns;
+	unsigned int bucket;
+
+	do_div(usecs, NSEC_PER_USEC);
+	if (!usecs)
+		return 0;
+	if (usecs >= 1ULL << (LOCK_PROF_BUCKETS - 2))
+		return LOCK_PROF_BUCKETS - 1;
+	bucket = ilog2((unsigned long)usecs) + 1;
+	return bucket;
+}
+
+void lock_prof_acquired(void *lock, unsigned long op, unsigned long ip,
+			u64 start)
+{
+	struct lock_prof_entry *e;
+	unsigned long flags;
+	unsigned int i, idx;
+	u64 wait_ns;
+
+	if (!start)
+		return;
+	wait_ns = cpu_clock(raw_smp_processor_id()) - start;
+	if ((s64)wait_ns < 0)
+		wait_ns = 0;
+
+	idx = hash_long(op ^ ip, LOCK_PROF_HASH_BITS);
+
+	local_irq_save(flags);
+	arch_spin_lock(&lock_prof_lock);
+
+	for (i = 0; i < LOCK_PROF_ENTRIES; i++) {
+		e = &lock_prof_table[(idx + i) & (LOCK_PROF_ENTRIES - 1)];
+		if (e->ip == ip && e->op == op)
+			break;
+		if (!e->ip) {
+			e->op = op;
+			e->ip = ip;
+			break;
+		}
+	}
+
+	if (i < LOCK_PROF_ENTRIES) {
+		e->lock = (unsigned long)lock;
+		e->count++;
+		e->total_ns += wait_ns;
+		if (wait_ns > e->max_ns)
+			e->max_ns = wait_ns;
+		e->hist[lock_prof_bucket(wait_ns)]++;
+	} else
+		lock_prof_dropped++;
+
+	arch_spin_unlock(&lock_prof_lock);
+	local_irq_restore(flags);
+
+	if (i == LOCK_PROF_ENTRIES)
+		printk_once(KERN_WARNING "lock_prof: table full, "
+			    "dropping samples\n");
+}
+EXPORT_SYMBOL(lock_prof_acquired);
+
+static void *lc_start(struct seq_file *m, loff_t *pos)
+{
+	if (*pos == 0)
+		return SEQ_START_TOKEN;
+
+	for (; *pos <= LOCK_PROF_ENTRIES; ++*pos)
+		if (lock_prof_table[*pos - 1].ip)
+			return &lock_prof_table[*pos - 1];
+	return NULL;
+}
+
+static void *lc_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return lc_start(m, pos);
+}
+
+static void lc_stop(struct seq_file *m, void *v)
+{
+}
+
+static int lc_show(struct seq_file *m, void *v)
+{
+	struct lock_prof_entry e, *p = v;
+	unsigned long flags;
+	u64 total_us, max_us;
+	int i;
+
+	if (v == SEQ_START_TOKEN) {
+		seq_printf(m, "# dropped: %lu\n", lock_prof_dropped);
+		seq_printf(m, "# function caller last_lock count total_us "
+			   "max_us histogram(<1us <2us <4us ... >=16ms)\n");
+		return 0;
+	}
+
+	/* take a consistent snapshot */
+	local_irq_save(flags);
+	arch_spin_lock(&lock_prof_lock);
+	e = *p;
+	arch_spin_unlock(&lock_prof_lock);
+	local_irq_restore(flags);
+
+	if (!e.ip)
+		return 0;
+
+	total_us = e.total_ns;
+	do_div(total_us, NSEC_PER_USEC);
+	max_us = e.max_ns;
+	do_div(max_us, NSEC_PER_USEC);
+
+	seq_printf(m, "%pf %pS %pS %lu %llu %llu",
+		   (void *)e.op, (void *)e.ip, (void *)e.lock, e.count,
+		   (unsigned long long)total_us, (unsigned long long)max_us);
+	for (i = 0; i < LOCK_PROF_BUCKETS; i++)
+		seq_printf(m, " %u", e.hist[i]);
+	seq_putc(m, '\n');
+	return 0;
+}
+
+static const struct seq_operations lock_contention_ops = {
+	.start	= lc_start,
+	.next	= lc_next,
+	.stop	= lc_stop,
+	.show	= lc_show,
+};
+
+static int lock_contention_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &lock_contention_ops);
+}
+
+static ssize_t lock_contention_write(struct file *file,
+				     const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+	char c;
+
+	if (count) {
+		if (get_user(c, buf))
+			return -EFAULT;
+
+		if (c != '0')
+			return count;
+
+		local_irq_save(flags);
+		arch_spin_lock(&lock_prof_lock);
+		memset(lock_prof_table, 0, sizeof(lock_prof_table));
+		lock_prof_dropped = 0;
+		arch_spin_unlock(&lock_prof_lock);
+		local_irq_restore(flags);
+	}
+	return count;
+}
+
+static const struct file_operations proc_lock_contention_operations = {
+	.open		= lock_contention_open,
+	.write		= lock_contention_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init lock_prof_init(void)
+{
+	proc_create("lock_contention", S_IRUSR | S_IWUSR, NULL,
+		    &proc_lock_contention_operations);
+	return 0;
+}
+__initcall(lock_prof_init);
@@ -68,6 +68,12 @@ EXPORT_SYMBOL(__mutex_init);
 static __used noinline void __sched
 __mutex_lock_slowpath(atomic_t *lock_count);
 
+#ifdef CONFIG_LOCK_CONTENTION_PROF
+static inline int __sched
+__mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
+		    unsigned long ip);
+#endif
+
 /***
  * mutex_lock - acquire the mutex
  * @lock: the mutex to be acquired
@@ -96,7 +102,13 @@ void __sched mutex_lock(struct mutex *lock)
 	 * The locking fastpath is the 1->0 transition from
 	 * 'unlocked' into 'locked' state.
 	 */
+#ifdef CONFIG_LOCK_CONTENTION_PROF
+	/* enter the slowpath from here, so that it knows our caller */
+	if (unlikely(atomic_cmpxchg(&lock->count, 1, 0) != 1))
+		__mutex_lock_common(lock, TASK_UNINTERRUPTIBLE, 0, _RET_IP_);
+#else
 	__mutex_fastpath_lock(&lock->count, __mutex_lock_slowpath);
+#endif
 	mutex_set_owner(lock);
 }
 
@@ -145,9 +157,12 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 	struct task_struct *task = current;
 	struct mutex_waiter waiter;
 	unsigned long flags;
+	u64 wait_start;
 
 	preempt_disable();
 	mutex_acquire(&lock->dep_map, subclass, 0, ip);
+	/* the fastpath failed: the wait includes any spinning below */
+	wait_start = lock_prof_start();
 
 #ifdef CONFIG_MUTEX_SPIN_ON_OWNER
 	/*
@@ -187,6 +202,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 			break;
 
 		if (atomic_cmpxchg(&lock->count, 1, 0) == 1) {
+			lock_prof_acquired(lock, _THIS_IP_, ip, wait_start);
 			lock_acquired(&lock->dep_map, ip);
 			mutex_set_owner(lock);
 			preempt_enable();
@@ -263,6 +279,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 	}
 
 done:
+	lock_prof_acquired(lock, _THIS_IP_, ip, wait_start);
 	lock_acquired(&lock->dep_map, ip);
 	/* got the lock - rejoice! */
 	mutex_remove_waiter(lock, &waiter, current_thread_info());
@@ -358,11 +375,13 @@ __mutex_unlock_slowpath(atomic_t *lock_count)
  * Here come the less common (and hence less performance-critical) APIs:
  * mutex_lock_interruptible() and mutex_trylock().
  */
+#ifndef CONFIG_LOCK_CONTENTION_PROF
 static noinline int __sched
 __mutex_lock_killable_slowpath(atomic_t *lock_count);
 
 static noinline int __sched
 __mutex_lock_interruptible_slowpath(atomic_t *lock_count);
+#endif
 
 /***
  * mutex_lock_interruptible - acquire the mutex, interruptable
@@ -380,8 +399,16 @@ int __sched mutex_lock_interruptible(struct mutex *lock)
 	int ret;
 
 	might_sleep();
+#ifdef CONFIG_LOCK_CONTENTION_PROF
+	if (likely(atomic_cmpxchg(&lock->count, 1, 0) == 1))
+		ret = 0;
+	else
+		ret = __mutex_lock_common(lock, TASK_INTERRUPTIBLE, 0,
+					  _RET_IP_);
+#else
 	ret =  __mutex_fastpath_lock_retval
 			(&lock->count, __mutex_lock_interruptible_slowpath);
+#endif
 	if (!ret)
 		mutex_set_owner(lock);
 
@@ -395,8 +422,15 @@ int __sched mutex_lock_killable(struct mutex *lock)
 	int ret;
 
 	might_sleep();
+#ifdef CONFIG_LOCK_CONTENTION_PROF
+	if (likely(atomic_cmpxchg(&lock->count, 1, 0) == 1))
+		ret = 0;
+	else
+		ret = __mutex_lock_common(lock, TASK_KILLABLE, 0, _RET_IP_);
+#else
 	ret = __mutex_fastpath_lock_retval
 			(&lock->count, __mutex_lock_killable_slowpath);
+#endif
 	if (!ret)
 		mutex_set_owner(lock);
 
@@ -412,6 +446,7 @@ __mutex_lock_slowpath(atomic_t *lock_count)
 	__mutex_lock_common(lock, TASK_UNINTERRUPTIBLE, 0, _RET_IP_);
 }
 
+#ifndef CONFIG_LOCK_CONTENTION_PROF
 static noinline int __sched
 __mutex_lock_killable_slowpath(atomic_t *lock_count)
 {
@@ -428,6 +463,7 @@ __mutex_lock_interruptible_slowpath(atomic_t *lock_count)
 	return __mutex_lock_common(lock, TASK_INTERRUPTIBLE, 0, _RET_IP_);
 }
 #endif
+#endif
 
 /*
  * Spinlock based trylock, we take the spinlock and check whether we
@@ -39,6 +39,7 @@
 #include <linux/syslog.h>
 #include <linux/cpu.h>
 #include <linux/notifier.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -121,6 +122,15 @@ static unsigned log_start;	/* Index into log_buf: next char to be read by syslog
 static unsigned con_start;	/* Index into log_buf: next char to be sent to consoles */
 static unsigned log_end;	/* Index into log_buf: most-recently-written-char + 1 */
 
+/*
+ * Console output statistics, in bytes.  Dropped counts text which was
+ * overwritten in log_buf before it could be sent to the consoles, the
+ * backlog is what printk() left for the consoles to catch up with.
+ */
+unsigned long printk_console_dropped;
+unsigned long printk_console_backlog;
+unsigned long printk_console_backlog_max;
+
 /*
  *	Array of consoles built from command line options (console=)
  */
@@ -145,6 +155,17 @@ EXPORT_SYMBOL(console_set_on_cmdline);
 /* Flag: console code may call schedule() */
 static int console_may_schedule;
 
+/*
+ * Work printk() leaves for the next tick on this cpu: waking up klogd
+ * and, with printk_deferred, the printk thread.
+ */
+#define PRINTK_PENDING_WAKEUP	0x01
+#define PRINTK_PENDING_OUTPUT	0x02
+
+static DEFINE_PER_CPU(int, printk_pending);
+
+static struct task_struct *printk_thread;
+
 #ifdef CONFIG_PRINTK
 
 static char __log_buf[__LOG_BUF_LEN];
@@ -598,8 +619,10 @@ static void emit_log_char(char c)
 	log_end++;
 	if (log_end - log_start > log_buf_len)
 		log_start = log_end - log_buf_len;
-	if (log_end - con_start > log_buf_len)
+	if (log_end - con_start > log_buf_len) {
 		con_start = log_end - log_buf_len;
+		printk_console_dropped++;
+	}
 	if (logged_chars < log_buf_len)
 		logged_chars++;
 }
@@ -743,6 +766,29 @@ static char printk_buf[1024];
 
 int printk_delay_msec __read_mostly;
 
+/*
+ * With printk_deferred set, printk() only appends to log_buf and the
+ * console output is done by the printk thread, so that a slow serial
+ * console doesn't stall whoever is calling printk().  Messages are
+ * still written synchronously when oopsing or panicking, and while
+ * the system is going down; these flush the backlog on their way.
+ */
+int printk_deferred __read_mostly;
+
+static int __init printk_deferred_setup(char *str)
+{
+	printk_deferred = 1;
+	return 0;
+}
+early_param("printk_deferred", printk_deferred_setup);
+
+static inline int printk_defer_output(void)
+{
+	return printk_deferred && printk_thread && !oops_in_progress &&
+		(system_state == SYSTEM_BOOTING ||
+		 system_state == SYSTEM_RUNNING);
+}
+
 static inline void printk_delay(void)
 {
 	if (unlikely(printk_delay_msec)) {
@@ -869,18 +915,32 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 			new_text_line = 1;
 	}
 
-	/*
-	 * Try to acquire and then immediately release the
-	 * console semaphore. The release will do all the
-	 * actual magic (print out buffers, wake up klogd,
-	 * etc). 
-	 *
-	 * The acquire_console_semaphore_for_printk() function
-	 * will release 'logbuf_lock' regardless of whether it
-	 * actually gets the semaphore or not.
-	 */
-	if (acquire_console_semaphore_for_printk(this_cpu))
+	printk_console_backlog = log_end - con_start;
+	if (printk_console_backlog > printk_console_backlog_max)
+		printk_console_backlog_max = printk_console_backlog;
+
+	if (printk_defer_output()) {
+		/*
+		 * Leave the output to the printk thread.  It can't be
+		 * woken up from here, we may be holding a runqueue lock;
+		 * the next tick does it.
+		 */
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+		__raw_get_cpu_var(printk_pending) |= PRINTK_PENDING_OUTPUT;
+	} else if (acquire_console_semaphore_for_printk(this_cpu)) {
+		/*
+		 * Try to acquire and then immediately release the
+		 * console semaphore. The release will do all the
+		 * actual magic (print out buffers, wake up klogd,
+		 * etc).
+		 *
+		 * The acquire_console_semaphore_for_printk() function
+		 * will release 'logbuf_lock' regardless of whether it
+		 * actually gets the semaphore or not.
+		 */
 		release_console_sem();
+	}
 
 	lockdep_on();
 out_restore_irqs:
@@ -1130,13 +1190,16 @@ int is_console_locked(void)
 	return console_locked;
 }
 
-static DEFINE_PER_CPU(int, printk_pending);
-
 void printk_tick(void)
 {
-	if (__get_cpu_var(printk_pending)) {
+	int pending = __get_cpu_var(printk_pending);
+
+	if (pending) {
 		__get_cpu_var(printk_pending) = 0;
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_OUTPUT)
+			wake_up_process(printk_thread);
 	}
 }
 
@@ -1148,7 +1211,7 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		__raw_get_cpu_var(printk_pending) = 1;
+		__raw_get_cpu_var(printk_pending) |= PRINTK_PENDING_WAKEUP;
 }
 
 /**
@@ -1181,8 +1244,10 @@ void release_console_sem(void)
 	for ( ; ; ) {
 		spin_lock_irqsave(&logbuf_lock, flags);
 		wake_klogd |= log_start - log_end;
-		if (con_start == log_end)
+		if (con_start == log_end) {
+			printk_console_backlog = 0;
 			break;			/* Nothing to print */
+		}
 		_con_start = con_start;
 		_log_end = log_end;
 		con_start = log_end;		/* Flush */
@@ -1200,6 +1265,75 @@ void release_console_sem(void)
 }
 EXPORT_SYMBOL(release_console_sem);
 
+#ifdef CONFIG_PRINTK
+/*
+ * Bytes the printk thread hands to the consoles at a time, with
+ * interrupts disabled just like the synchronous path does.
+ */
+#define PRINTK_THREAD_CHUNK	256
+
+static void printk_thread_flush(void)
+{
+	unsigned long flags;
+	unsigned _con_start, _log_end;
+
+	for ( ; ; ) {
+		spin_lock_irqsave(&logbuf_lock, flags);
+		if (con_start == log_end) {
+			spin_unlock_irqrestore(&logbuf_lock, flags);
+			break;
+		}
+		_con_start = con_start;
+		_log_end = log_end;
+		if (_log_end - _con_start > PRINTK_THREAD_CHUNK)
+			_log_end = _con_start + PRINTK_THREAD_CHUNK;
+		con_start = _log_end;
+		spin_unlock(&logbuf_lock);
+		stop_critical_timings();	/* don't trace print latency */
+		call_console_drivers(_con_start, _log_end);
+		start_critical_timings();
+		local_irq_restore(flags);
+		cond_resched();
+	}
+}
+
+static int printk_thread_fn(void *unused)
+{
+	set_user_nice(current, 19);
+
+	for ( ; ; ) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (con_start == log_end || console_suspended) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		acquire_console_sem();
+		if (console_locked)
+			printk_thread_flush();
+		release_console_sem();
+	}
+
+	return 0;
+}
+
+static int __init printk_thread_init(void)
+{
+	struct task_struct *p;
+
+	p = kthread_run(printk_thread_fn, NULL, "kprintkd");
+	if (IS_ERR(p)) {
+		printk(KERN_ERR "printk: failed to start printk thread, "
+		       "console output stays synchronous\n");
+		return PTR_ERR(p);
+	}
+	printk_thread = p;
+	return 0;
+}
+early_initcall(printk_thread_init);
+#endif
+
 /**
  * console_conditional_schedule - yield the CPU if required
  *
@@ -268,6 +268,18 @@ find_matching_se(struct sched_entity **se, struct sched_entity **pse)
 #endif	/* CONFIG_FAIR_GROUP_SCHED */
 
 
+/*
+ * Has this entity's task asked for low wakeup latency (PR_SET_LATENCY_BOOST)?
+ * Boosted tasks get a quarter of the wakeup granularity and full sleeper
+ * credit; their share of the cpu is unchanged.
+ */
+#define LATENCY_BOOST_GRAN_SHIFT	2
+
+static inline int entity_latency_boost(struct sched_entity *se)
+{
+	return entity_is_task(se) && task_of(se)->latency_boost;
+}
+
 /**************************************************************
  * Scheduling class tree data structure manipulation methods:
  */
@@ -495,6 +507,11 @@ static u64 sched_vslice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	return calc_delta_fair(sched_slice(cfs_rq, se), se);
 }
 
+static void
+account_cfs_rq_runtime(struct cfs_rq *cfs_rq, unsigned long delta_exec);
+static void check_enqueue_throttle(struct cfs_rq *cfs_rq);
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq);
+
 /*
  * Update the current task's runtime statistics. Skip current tasks that
  * are not in our scheduling class.
@@ -544,6 +561,8 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		cpuacct_charge(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
 	}
+
+	account_cfs_rq_runtime(cfs_rq, delta_exec);
 }
 
 static inline void
@@ -743,9 +762,12 @@ place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int initial)
 
 		/*
 		 * Halve their sleep time's effect, to allow
-		 * for a gentler effect of sleepers:
+		 * for a gentler effect of sleepers; latency boosted
+		 * tasks get the full credit so that they are placed
+		 * ahead on wakeup:
 		 */
-		if (sched_feat(GENTLE_FAIR_SLEEPERS))
+		if (sched_feat(GENTLE_FAIR_SLEEPERS) &&
+		    !entity_latency_boost(se))
 			thresh >>= 1;
 
 		vruntime -= thresh;
@@ -782,6 +804,9 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	check_spread(cfs_rq, se);
 	if (se != cfs_rq->curr)
 		__enqueue_entity(cfs_rq, se);
+
+	if (cfs_rq->nr_running == 1)
+		check_enqueue_throttle(cfs_rq);
 }
 
 static void __clear_buddies(struct cfs_rq *cfs_rq, struct sched_entity *se)
@@ -942,6 +967,9 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 	if (prev->on_rq)
 		update_curr(cfs_rq);
 
+	/* throttle cfs_rqs that ran out of bandwidth */
+	check_cfs_rq_runtime(cfs_rq);
+
 	check_spread(cfs_rq, prev);
 	if (prev->on_rq) {
 		update_stats_wait_start(cfs_rq, prev);
@@ -980,6 +1008,401 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 		check_preempt_tick(cfs_rq, curr);
 }
 
+/**************************************************
+ * CFS bandwidth control machinery
+ */
+
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * Amount of runtime a cfs_rq pulls from its group's global pool at once:
+ * (default: 5 msec, units: microseconds)
+ */
+unsigned int sysctl_sched_cfs_bandwidth_slice = 5000UL;
+
+static inline u64 default_cfs_period(void)
+{
+	return 100000000ULL;	/* 100ms */
+}
+
+static inline u64 sched_cfs_bandwidth_slice(void)
+{
+	return (u64)sysctl_sched_cfs_bandwidth_slice * NSEC_PER_USEC;
+}
+
+static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
+{
+	return &tg->cfs_bandwidth;
+}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq->throttled;
+}
+
+/* is this cfs_rq, or one of its parents, throttled? */
+static int throttled_hierarchy(struct cfs_rq *cfs_rq)
+{
+	int cpu = cpu_of(rq_of(cfs_rq));
+	struct sched_entity *se;
+
+	for (;;) {
+		if (cfs_rq_throttled(cfs_rq))
+			return 1;
+
+		se = cfs_rq->tg->se[cpu];
+		if (!se)
+			return 0;
+		cfs_rq = cfs_rq_of(se);
+	}
+}
+
+/*
+ * Arm the period timer; called with cfs_b->lock held.
+ *
+ * The timer may still be active because the callback is on its way out
+ * (timer_active is cleared before it returns); the callback no longer
+ * needs any rq->lock at that point so it is safe to wait for it here.
+ */
+static void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	while (unlikely(hrtimer_active(&cfs_b->period_timer))) {
+		raw_spin_unlock(&cfs_b->lock);
+		hrtimer_cancel(&cfs_b->period_timer);
+		raw_spin_lock(&cfs_b->lock);
+		/* somebody else restarted it meanwhile */
+		if (cfs_b->timer_active)
+			return;
+	}
+
+	/* a restarted timer starts a fresh period */
+	cfs_b->runtime = cfs_b->quota;
+	cfs_b->timer_active = 1;
+	start_bandwidth_timer(&cfs_b->period_timer, cfs_b->period);
+}
+
+/*
+ * Top up cfs_rq->runtime_remaining to a full slice from the global pool,
+ * or as much of it as is left.
+ */
+static void assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	u64 amount = 0, min_amount;
+
+	/* runtime_remaining <= 0 here, so this is a positive amount */
+	min_amount = sched_cfs_bandwidth_slice() - cfs_rq->runtime_remaining;
+
+	raw_spin_lock(&cfs_b->lock);
+	if (cfs_b->quota == RUNTIME_INF)
+		amount = min_amount;
+	else {
+		if (!cfs_b->timer_active)
+			__start_cfs_bandwidth(cfs_b);
+
+		if (cfs_b->runtime > 0) {
+			amount = min(cfs_b->runtime, min_amount);
+			cfs_b->runtime -= amount;
+			cfs_b->idle = 0;
+		}
+	}
+	raw_spin_unlock(&cfs_b->lock);
+
+	cfs_rq->runtime_remaining += amount;
+}
+
+static void
+account_cfs_rq_runtime(struct cfs_rq *cfs_rq, unsigned long delta_exec)
+{
+	if (!cfs_rq->runtime_enabled)
+		return;
+
+	cfs_rq->runtime_remaining -= delta_exec;
+	if (likely(cfs_rq->runtime_remaining > 0))
+		return;
+
+	assign_cfs_rq_runtime(cfs_rq);
+	/*
+	 * Out of bandwidth: get the current entity off the cpu, the
+	 * cfs_rq is throttled from put_prev_entity().
+	 */
+	if (cfs_rq->runtime_remaining <= 0 && cfs_rq->curr)
+		resched_task(rq_of(cfs_rq)->curr);
+}
+
+static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se;
+	unsigned long task_delta;
+	int dequeue = 1;
+
+	se = cfs_rq->tg->se[cpu_of(rq)];
+	task_delta = cfs_rq->h_nr_running;
+
+	for_each_sched_entity(se) {
+		struct cfs_rq *qcfs_rq = cfs_rq_of(se);
+
+		/* throttled parent, or we're not queued yet */
+		if (!se->on_rq)
+			break;
+
+		if (dequeue)
+			dequeue_entity(qcfs_rq, se, DEQUEUE_SLEEP);
+		qcfs_rq->h_nr_running -= task_delta;
+
+		/* Don't dequeue parent if it has other entities besides us */
+		if (qcfs_rq->load.weight)
+			dequeue = 0;
+	}
+
+	/* the throttled tasks no longer count as runnable on this cpu */
+	if (!se)
+		rq->nr_running -= task_delta;
+
+	cfs_rq->throttled = 1;
+	cfs_rq->throttled_timestamp = rq->clock;
+
+	raw_spin_lock(&cfs_b->lock);
+	list_add_tail_rcu(&cfs_rq->throttled_list, &cfs_b->throttled_cfs_rq);
+	raw_spin_unlock(&cfs_b->lock);
+}
+
+static void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se;
+	unsigned long task_delta;
+	int enqueue = 1;
+
+	se = cfs_rq->tg->se[cpu_of(rq)];
+
+	cfs_rq->throttled = 0;
+
+	raw_spin_lock(&cfs_b->lock);
+	cfs_b->throttled_time += rq->clock - cfs_rq->throttled_timestamp;
+	list_del_rcu(&cfs_rq->throttled_list);
+	raw_spin_unlock(&cfs_b->lock);
+
+	/* nothing became runnable while we were throttled */
+	if (!cfs_rq->load.weight)
+		return;
+
+	task_delta = cfs_rq->h_nr_running;
+	for_each_sched_entity(se) {
+		if (se->on_rq)
+			enqueue = 0;
+
+		cfs_rq = cfs_rq_of(se);
+		if (enqueue)
+			enqueue_entity(cfs_rq, se, ENQUEUE_WAKEUP);
+		cfs_rq->h_nr_running += task_delta;
+
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	if (!se)
+		rq->nr_running += task_delta;
+
+	/* a cpu that went idle because of the throttle has work again */
+	if (rq->curr == rq->idle && rq->cfs.nr_running)
+		resched_task(rq->curr);
+}
+
+/*
+ * Hand out @remaining runtime to the throttled cfs_rqs of @cfs_b, just
+ * enough to get each of them going again; returns what is left over.
+ */
+static u64 distribute_cfs_runtime(struct cfs_bandwidth *cfs_b, u64 remaining)
+{
+	struct cfs_rq *cfs_rq;
+	u64 runtime;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(cfs_rq, &cfs_b->throttled_cfs_rq,
+				throttled_list) {
+		struct rq *rq = rq_of(cfs_rq);
+
+		raw_spin_lock(&rq->lock);
+		if (!cfs_rq_throttled(cfs_rq))
+			goto next;
+
+		runtime = -cfs_rq->runtime_remaining + 1;
+		if (runtime > remaining)
+			runtime = remaining;
+		remaining -= runtime;
+
+		cfs_rq->runtime_remaining += runtime;
+		if (cfs_rq->runtime_remaining > 0) {
+			update_rq_clock(rq);
+			unthrottle_cfs_rq(cfs_rq);
+		}
+next:
+		raw_spin_unlock(&rq->lock);
+
+		if (!remaining)
+			break;
+	}
+	rcu_read_unlock();
+
+	return remaining;
+}
+
+/*
+ * Refill the global pool at the start of each period and unthrottle
+ * whoever ran out during the last one. Returns 1 once the group has been
+ * inactive for a whole period, after which the timer is stopped until the
+ * next assign_cfs_rq_runtime() restarts it.
+ */
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
+{
+	u64 runtime;
+	int throttled, idle = 1;
+
+	raw_spin_lock(&cfs_b->lock);
+	if (cfs_b->quota == RUNTIME_INF)
+		goto out_unlock;
+
+	throttled = !list_empty(&cfs_b->throttled_cfs_rq);
+	idle = cfs_b->idle && !throttled;
+	cfs_b->nr_periods += overrun;
+
+	if (idle)
+		goto out_unlock;
+
+	cfs_b->runtime = cfs_b->quota;
+	cfs_b->idle = 1;
+
+	if (!throttled)
+		goto out_unlock;
+
+	cfs_b->nr_throttled += overrun;
+
+	/*
+	 * cfs_b->lock nests inside rq->lock, so it has to be dropped while
+	 * distributing; keep the pool empty meanwhile so the throttled
+	 * cfs_rqs get the first go at this period's runtime.
+	 */
+	runtime = cfs_b->runtime;
+	cfs_b->runtime = 0;
+	raw_spin_unlock(&cfs_b->lock);
+
+	runtime = distribute_cfs_runtime(cfs_b, runtime);
+
+	raw_spin_lock(&cfs_b->lock);
+	cfs_b->runtime = runtime;
+
+out_unlock:
+	if (idle)
+		cfs_b->timer_active = 0;
+	raw_spin_unlock(&cfs_b->lock);
+
+	return idle;
+}
+
+static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
+{
+	struct cfs_bandwidth *cfs_b =
+		container_of(timer, struct cfs_bandwidth, period_timer);
+	ktime_t now;
+	int overrun;
+	int idle = 0;
+
+	for (;;) {
+		now = hrtimer_cb_get_time(timer);
+		overrun = hrtimer_forward(timer, now, cfs_b->period);
+
+		if (!overrun)
+			break;
+
+		idle = do_sched_cfs_period_timer(cfs_b, overrun);
+		/* timer_active is clear, don't touch the rqs again */
+		if (idle)
+			break;
+	}
+
+	return idle ? HRTIMER_NORESTART : HRTIMER_RESTART;
+}
+
+static void check_enqueue_throttle(struct cfs_rq *cfs_rq)
+{
+	/* a running cfs_rq is throttled from put_prev_entity() */
+	if (!cfs_rq->runtime_enabled || cfs_rq->curr)
+		return;
+
+	if (cfs_rq_throttled(cfs_rq))
+		return;
+
+	/* update the runtime allocation */
+	account_cfs_rq_runtime(cfs_rq, 0);
+	if (cfs_rq->runtime_remaining <= 0)
+		throttle_cfs_rq(cfs_rq);
+}
+
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	if (likely(!cfs_rq->runtime_enabled || cfs_rq->runtime_remaining > 0))
+		return;
+
+	if (cfs_rq_throttled(cfs_rq))
+		return;
+
+	throttle_cfs_rq(cfs_rq);
+}
+
+static void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	raw_spin_lock_init(&cfs_b->lock);
+	cfs_b->runtime = 0;
+	cfs_b->quota = RUNTIME_INF;
+	cfs_b->period = ns_to_ktime(default_cfs_period());
+
+	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
+	hrtimer_init(&cfs_b->period_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cfs_b->period_timer.function = sched_cfs_period_timer;
+}
+
+static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	hrtimer_cancel(&cfs_b->period_timer);
+}
+
+static void init_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	cfs_rq->runtime_enabled = 0;
+	INIT_LIST_HEAD(&cfs_rq->throttled_list);
+}
+#else /* !CONFIG_CFS_BANDWIDTH */
+static inline void
+account_cfs_rq_runtime(struct cfs_rq *cfs_rq, unsigned long delta_exec)
+{
+}
+
+static inline void check_enqueue_throttle(struct cfs_rq *cfs_rq)
+{
+}
+
+static inline void check_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline int throttled_hierarchy(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline void init_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 /**************************************************
  * CFS operations on tasks:
  */
@@ -1056,9 +1479,27 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 			break;
 		cfs_rq = cfs_rq_of(se);
 		enqueue_entity(cfs_rq, se, flags);
+		/*
+		 * a throttled cfs_rq keeps its entities off the parent; its
+		 * h_nr_running is accounted for below
+		 */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		cfs_rq->h_nr_running++;
 		flags = ENQUEUE_WAKEUP;
 	}
 
+	/* the rest of the hierarchy up to the first throttled cfs_rq */
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		cfs_rq->h_nr_running++;
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	/* a task in a throttled group is not runnable on this cpu */
+	if (!se)
+		inc_nr_running(rq);
 	hrtick_update(rq);
 }
 
@@ -1075,12 +1516,27 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
+		/* a throttled cfs_rq is not queued on its parent */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		cfs_rq->h_nr_running--;
 		/* Don't dequeue parent if it has other entities besides us */
-		if (cfs_rq->load.weight)
+		if (cfs_rq->load.weight) {
+			se = parent_entity(se);
 			break;
+		}
 		flags |= DEQUEUE_SLEEP;
 	}
 
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		cfs_rq->h_nr_running--;
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	if (!se)
+		dec_nr_running(rq);
 	hrtick_update(rq);
 }
 
@@ -1601,6 +2057,14 @@ wakeup_gran(struct sched_entity *curr, struct sched_entity *se)
 	if (unlikely(se->load.weight != NICE_0_LOAD))
 		gran = calc_delta_fair(gran, se);
 
+	/*
+	 * A latency boosted task gets to preempt at a finer granularity;
+	 * this only applies where the task itself competes with curr, not
+	 * to the group entities above it.
+	 */
+	if (unlikely(entity_latency_boost(se)))
+		gran >>= LATENCY_BOOST_GRAN_SHIFT;
+
 	return gran;
 }
 
@@ -1692,6 +2156,10 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	if (!sched_feat(WAKEUP_PREEMPT))
 		return;
 
+	/* a task woken into a throttled group can't run anyway */
+	if (unlikely(throttled_hierarchy(cfs_rq_of(pse))))
+		return;
+
 	update_curr(cfs_rq);
 	find_matching_se(&se, &pse);
 	BUG_ON(!pse);
@@ -1945,6 +2413,14 @@ load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 		if (!busiest_cfs_rq->task_weight)
 			continue;
 
+		/*
+		 * throttled groups have nothing runnable to give away and
+		 * can't take on any more work either
+		 */
+		if (throttled_hierarchy(busiest_cfs_rq) ||
+		    throttled_hierarchy(tg->cfs_rq[this_cpu]))
+			continue;
+
 		rem_load = (u64)rem_load_move * busiest_weight;
 		rem_load = div_u64(rem_load, busiest_h_load + 1);
 
@@ -150,6 +150,70 @@ rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 # define schedstat_set(var, val)	do { } while (0)
 #endif
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Per task and per cpu cgroup histograms of the time spent waiting for
+ * the cpu, off by default to keep the context switch path lean:
+ */
+unsigned int sysctl_sched_latency_hist __read_mostly;
+
+static inline int sched_lat_hist_bucket(unsigned long long delta)
+{
+	delta >>= 10;
+	if (!delta)
+		return 0;
+
+	return min(fls64(delta), SCHED_LAT_HIST_BUCKETS - 1);
+}
+
+static inline void
+__sched_lat_hist_add(struct sched_lat_hist *hist, int preempted, int bucket)
+{
+	if (preempted)
+		hist->preempt[bucket]++;
+	else
+		hist->wakeup[bucket]++;
+}
+
+/*
+ * Record @delta, the wait that ended with @t hitting the cpu, in the task's
+ * histogram and in those of its task group and all the groups above it.
+ */
+static void sched_lat_hist_account(struct task_struct *t,
+				   unsigned long long delta)
+{
+	int preempted = t->sched_info.lat_preempted;
+	int bucket;
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg;
+#endif
+
+	delta += t->sched_info.lat_pending;
+	t->sched_info.lat_pending = 0;
+	t->sched_info.lat_preempted = 0;
+
+	if (likely(!sysctl_sched_latency_hist))
+		return;
+
+	bucket = sched_lat_hist_bucket(delta);
+	__sched_lat_hist_add(&t->sched_info.lat_hist, preempted, bucket);
+
+#ifdef CONFIG_CGROUP_SCHED
+	/* the root group's histogram is allocated at boot and may be missing */
+	for (tg = task_group(t); tg; tg = tg->parent)
+		if (likely(tg->lat_hist))
+			__sched_lat_hist_add(per_cpu_ptr(tg->lat_hist,
+							 task_cpu(t)),
+					     preempted, bucket);
+#endif
+}
+#else
+static inline void sched_lat_hist_account(struct task_struct *t,
+					  unsigned long long delta)
+{
+}
+#endif /* CONFIG_SCHEDSTATS */
+
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 static inline void sched_info_reset_dequeued(struct task_struct *t)
 {
@@ -179,6 +243,9 @@ static inline void sched_info_dequeued(struct task_struct *t)
 			delta = now - t->sched_info.last_queued;
 	sched_info_reset_dequeued(t);
 	t->sched_info.run_delay += delta;
+#ifdef CONFIG_SCHEDSTATS
+	t->sched_info.lat_pending += delta;
+#endif
 
 	rq_sched_info_dequeued(task_rq(t), delta);
 }
@@ -198,6 +265,7 @@ static void sched_info_arrive(struct task_struct *t)
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
 	t->sched_info.pcount++;
+	sched_lat_hist_account(t, delta);
 
 	rq_sched_info_arrive(task_rq(t), delta);
 }
@@ -238,8 +306,12 @@ static inline void sched_info_depart(struct task_struct *t)
 
 	rq_sched_info_depart(task_rq(t), delta);
 
-	if (t->state == TASK_RUNNING)
+	if (t->state == TASK_RUNNING) {
 		sched_info_queued(t);
+#ifdef CONFIG_SCHEDSTATS
+		t->sched_info.lat_preempted = 1;
+#endif
+	}
 }
 
 /*
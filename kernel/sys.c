@@ -1465,6 +1465,42 @@ SYSCALL_DEFINE1(umask, int, mask)
 	return mask;
 }
 
+/*
+ * Get or set the latency boost hint of thread @pid, or of the calling
+ * thread if @pid is 0.  Changing the hint of another thread takes
+ * CAP_SYS_NICE or the right to ptrace it.
+ */
+static int prctl_latency_boost(pid_t pid, int set, unsigned int boost)
+{
+	struct task_struct *p;
+	int error;
+
+	rcu_read_lock();
+	p = pid ? find_task_by_vpid(pid) : current;
+	if (!p) {
+		rcu_read_unlock();
+		return -ESRCH;
+	}
+	get_task_struct(p);
+	rcu_read_unlock();
+
+	if (!set) {
+		error = p->latency_boost;
+		goto out;
+	}
+
+	error = -EPERM;
+	if (p != current && !capable(CAP_SYS_NICE) &&
+	    !ptrace_may_access(p, PTRACE_MODE_ATTACH))
+		goto out;
+
+	p->latency_boost = boost;
+	error = 0;
+out:
+	put_task_struct(p);
+	return error;
+}
+
 SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 		unsigned long, arg4, unsigned long, arg5)
 {
@@ -1604,6 +1640,16 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			}
 			error = 0;
 			break;
+		case PR_SET_LATENCY_BOOST:
+			if (arg2 > 1 || arg3 > PID_MAX_LIMIT || arg4 | arg5)
+				return -EINVAL;
+			error = prctl_latency_boost(arg3, 1, arg2);
+			break;
+		case PR_GET_LATENCY_BOOST:
+			if (arg2 > PID_MAX_LIMIT || arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = prctl_latency_boost(arg2, 0, 0);
+			break;
 		case PR_MCE_KILL_GET:
 			if (arg2 | arg3 | arg4 | arg5)
 				return -EINVAL;
@@ -27,6 +27,8 @@
 #include <linux/cgroup.h>
 #include <linux/fs.h>
 #include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/pid_namespace.h>
 #include <net/genetlink.h>
 #include <asm/atomic.h>
 
@@ -492,6 +494,88 @@ err:
 	return rc;
 }
 
+static void fill_snap(struct task_struct *tsk, struct pid_namespace *ns,
+		struct taskstats_snap *snap)
+{
+	struct mm_struct *mm;
+
+	memset(snap, 0, sizeof(*snap));
+	snap->ts_version = TASKSTATS_SNAP_VERSION;
+	snap->ts_size = sizeof(*snap);
+	snap->ts_pid = task_pid_nr_ns(tsk, ns);
+	snap->ts_tgid = task_tgid_nr_ns(tsk, ns);
+	snap->ts_state = (tsk->state & TASK_REPORT) | tsk->exit_state;
+	snap->ts_oom_adj = tsk->signal->oom_adj;
+	snap->ts_cpu = task_cpu(tsk);
+	snap->ts_utime = cputime_to_msecs(tsk->utime) * USEC_PER_MSEC;
+	snap->ts_stime = cputime_to_msecs(tsk->stime) * USEC_PER_MSEC;
+
+	/*
+	 * exit_mm() clears ->mm under task_lock, so the counters stay
+	 * valid here without taking (and possibly dropping) a reference.
+	 */
+	task_lock(tsk);
+	mm = tsk->mm;
+	if (mm)
+		snap->ts_rss = get_mm_rss(mm);
+	task_unlock(tsk);
+}
+
+/*
+ * Stream a taskstats_snap record for every task in the caller's pid
+ * namespace. Records are packed as many to a message as fit, and
+ * cb->args[0] holds the pid to resume from when the skb fills up.
+ */
+static int taskstats_dump_cmd(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	struct task_struct *tsk;
+	struct nlattr *na;
+	struct pid *pid;
+	void *reply;
+	pid_t nr = cb->args[0];
+	int count = 0;
+
+	if (nr < 0)
+		return 0;
+
+	reply = genlmsg_put(skb, NETLINK_CB(cb->skb).pid, cb->nlh->nlmsg_seq,
+			    &family, NLM_F_MULTI, TASKSTATS_CMD_NEW);
+	if (!reply)
+		return -EMSGSIZE;
+
+	rcu_read_lock();
+	for (;;) {
+		pid = find_ge_pid(nr, ns);
+		if (!pid) {
+			nr = -1;
+			break;
+		}
+		nr = pid_nr_ns(pid, ns);
+		tsk = pid_task(pid, PIDTYPE_PID);
+		if (tsk) {
+			na = nla_reserve(skb, TASKSTATS_TYPE_SNAP,
+					 sizeof(struct taskstats_snap));
+			if (!na)
+				break;
+			fill_snap(tsk, ns, nla_data(na));
+			count++;
+		}
+		nr++;
+	}
+	rcu_read_unlock();
+
+	if (!count && nr >= 0) {
+		/* Not even one record fits, give up rather than loop */
+		genlmsg_cancel(skb, reply);
+		return -EMSGSIZE;
+	}
+
+	cb->args[0] = nr;
+	genlmsg_end(skb, reply);
+	return skb->len;
+}
+
 static struct taskstats *taskstats_tgid_alloc(struct task_struct *tsk)
 {
 	struct signal_struct *sig = tsk->signal;
@@ -584,6 +668,11 @@ static struct genl_ops taskstats_ops = {
 	.policy		= taskstats_cmd_get_policy,
 };
 
+static struct genl_ops taskstats_dump_ops = {
+	.cmd		= TASKSTATS_CMD_DUMP,
+	.dumpit		= taskstats_dump_cmd,
+};
+
 static struct genl_ops cgroupstats_ops = {
 	.cmd		= CGROUPSTATS_CMD_GET,
 	.doit		= cgroupstats_user_cmd,
@@ -606,6 +695,10 @@ static int __init taskstats_init(void)
 {
 	int rc;
 
+	/* command numbers are ABI, the two enums must not overlap */
+	BUILD_BUG_ON(CGROUPSTATS_CMD_UNSPEC != __TASKSTATS_CMD_MAX);
+	BUILD_BUG_ON(TASKSTATS_CMD_DUMP < __CGROUPSTATS_CMD_MAX);
+
 	rc = genl_register_family(&family);
 	if (rc)
 		return rc;
@@ -614,6 +707,10 @@ static int __init taskstats_init(void)
 	if (rc < 0)
 		goto err;
 
+	rc = genl_register_ops(&family, &taskstats_dump_ops);
+	if (rc < 0)
+		goto err_dump_ops;
+
 	rc = genl_register_ops(&family, &cgroupstats_ops);
 	if (rc < 0)
 		goto err_cgroup_ops;
@@ -622,6 +719,8 @@ static int __init taskstats_init(void)
 	printk("registered taskstats version %d\n", TASKSTATS_GENL_VERSION);
 	return 0;
 err_cgroup_ops:
+	genl_unregister_ops(&family, &taskstats_dump_ops);
+err_dump_ops:
 	genl_unregister_ops(&family, &taskstats_ops);
 err:
 	genl_unregister_family(&family);
@@ -758,8 +758,28 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 		unsigned long now = jiffies;
 
 		/* No slack, if already expired else auto slack 0.4% */
-		if (time_after(expires, now))
-			expires_limit = expires + (expires - now)/256;
+		if (time_after(expires, now)) {
+			unsigned long delta = expires - now;
+
+			expires_limit = expires + delta/256;
+
+			/*
+			 * Timers armed by a task with more than a jiffy of
+			 * timer slack, such as a background task in a timer
+			 * slack cgroup, may fire that much later, but by no
+			 * more than a quarter of their timeout so that short
+			 * timeouts stay short.
+			 */
+			if (!in_interrupt() &&
+			    current->timer_slack_ns >= TICK_NSEC) {
+				unsigned long slack;
+
+				slack = nsecs_to_jiffies(current->timer_slack_ns);
+				slack = min(slack, delta/4);
+				if (time_after(expires + slack, expires_limit))
+					expires_limit = expires + slack;
+			}
+		}
 	}
 	mask = expires ^ expires_limit;
 	if (mask == 0)
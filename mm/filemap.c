@@ -1551,6 +1551,7 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 		/* No page in the page cache at all */
 		do_sync_mmap_readahead(vma, ra, file, offset);
 		count_vm_event(PGMAJFAULT);
+		mem_cgroup_count_major_fault(vma->vm_mm, false);
 		ret = VM_FAULT_MAJOR;
 retry_find:
 		page = find_lock_page(mapping, offset);
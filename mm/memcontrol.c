@@ -86,6 +86,9 @@ enum mem_cgroup_stat_index {
 	MEM_CGROUP_STAT_PGPGIN_COUNT,	/* # of pages paged in */
 	MEM_CGROUP_STAT_PGPGOUT_COUNT,	/* # of pages paged out */
 	MEM_CGROUP_STAT_SWAPOUT, /* # of pages, swapped out */
+	MEM_CGROUP_STAT_SOFT_RECLAIMED, /* # of pages, soft limit reclaimed */
+	MEM_CGROUP_STAT_PGMAJFAULT, /* # of major faults */
+	MEM_CGROUP_STAT_SWAP_REFAULT, /* # of major faults on swapped pages */
 	MEM_CGROUP_EVENTS,	/* incremented at every  pagein/pageout */
 
 	MEM_CGROUP_STAT_NSTATS,
@@ -110,6 +113,8 @@ struct mem_cgroup_per_zone {
 	unsigned long long	usage_in_excess;/* Set to the value by which */
 						/* the soft limit is exceeded*/
 	bool			on_tree;
+	unsigned int		soft_reclaim_priority; /* mem's priority */
+						/* when put on the tree */
 	struct mem_cgroup	*mem;		/* Back pointer, we cannot */
 						/* use container_of	   */
 };
@@ -226,6 +231,11 @@ struct mem_cgroup {
 	atomic_t	refcnt;
 
 	unsigned int	swappiness;
+	/*
+	 * Order among groups over their soft limit in global reclaim:
+	 * a higher priority group is reclaimed first.
+	 */
+	unsigned int	soft_reclaim_priority;
 	/* OOM-Killer disable */
 	int		oom_kill_disable;
 
@@ -298,6 +308,9 @@ static bool move_file(void)
 #define	MEM_CGROUP_MAX_RECLAIM_LOOPS		(100)
 #define	MEM_CGROUP_MAX_SOFT_LIMIT_RECLAIM_LOOPS	(2)
 
+/* Highest value accepted for memory.soft_reclaim_priority */
+#define MEM_CGROUP_SOFT_RECLAIM_PRIORITY_MAX	(100)
+
 enum charge_type {
 	MEM_CGROUP_CHARGE_TYPE_CACHE = 0,
 	MEM_CGROUP_CHARGE_TYPE_MAPPED,
@@ -379,6 +392,20 @@ soft_limit_tree_from_page(struct page *page)
 	return &soft_limit_tree.rb_tree_per_node[nid]->rb_tree_per_zone[zid];
 }
 
+/*
+ * Soft limit tree order: by soft_reclaim_priority, then by the amount the
+ * soft limit is exceeded. Global reclaim starts from the rightmost node.
+ * The priority is copied into the node when it is inserted, so that the
+ * key of a node never changes while it is on the tree.
+ */
+static bool mem_cgroup_soft_limit_less(struct mem_cgroup_per_zone *a,
+				       struct mem_cgroup_per_zone *b)
+{
+	if (a->soft_reclaim_priority != b->soft_reclaim_priority)
+		return a->soft_reclaim_priority < b->soft_reclaim_priority;
+	return a->usage_in_excess < b->usage_in_excess;
+}
+
 static void
 __mem_cgroup_insert_exceeded(struct mem_cgroup *mem,
 				struct mem_cgroup_per_zone *mz,
@@ -395,17 +422,18 @@ __mem_cgroup_insert_exceeded(struct mem_cgroup *mem,
 	mz->usage_in_excess = new_usage_in_excess;
 	if (!mz->usage_in_excess)
 		return;
+	mz->soft_reclaim_priority = ACCESS_ONCE(mem->soft_reclaim_priority);
 	while (*p) {
 		parent = *p;
 		mz_node = rb_entry(parent, struct mem_cgroup_per_zone,
 					tree_node);
-		if (mz->usage_in_excess < mz_node->usage_in_excess)
+		if (mem_cgroup_soft_limit_less(mz, mz_node))
 			p = &(*p)->rb_left;
 		/*
 		 * We can't avoid mem cgroups that are over their soft
 		 * limit by the same amount
 		 */
-		else if (mz->usage_in_excess >= mz_node->usage_in_excess)
+		else
 			p = &(*p)->rb_right;
 	}
 	rb_link_node(&mz->tree_node, parent, p);
@@ -485,6 +513,37 @@ static void mem_cgroup_remove_from_trees(struct mem_cgroup *mem)
 	}
 }
 
+/*
+ * Change the soft reclaim priority of @mem. Nodes inserted from now on
+ * pick up the new priority; the ones already on a tree are moved to
+ * their new place under that tree's lock, so that a racing
+ * mem_cgroup_update_tree() always finds them either at the old or at
+ * the new position.
+ */
+static void mem_cgroup_set_soft_reclaim_priority(struct mem_cgroup *mem,
+						 unsigned int prio)
+{
+	int node, zone;
+	struct mem_cgroup_per_zone *mz;
+	struct mem_cgroup_tree_per_zone *mctz;
+
+	mem->soft_reclaim_priority = prio;
+
+	for_each_node_state(node, N_POSSIBLE) {
+		for (zone = 0; zone < MAX_NR_ZONES; zone++) {
+			mz = mem_cgroup_zoneinfo(mem, node, zone);
+			mctz = soft_limit_tree_node_zone(node, zone);
+			spin_lock(&mctz->lock);
+			if (mz->on_tree) {
+				__mem_cgroup_remove_exceeded(mem, mz, mctz);
+				__mem_cgroup_insert_exceeded(mem, mz, mctz,
+							mz->usage_in_excess);
+			}
+			spin_unlock(&mctz->lock);
+		}
+	}
+}
+
 static inline unsigned long mem_cgroup_get_excess(struct mem_cgroup *mem)
 {
 	return res_counter_soft_limit_excess(&mem->res) >> PAGE_SHIFT;
@@ -635,6 +694,28 @@ struct mem_cgroup *mem_cgroup_from_task(struct task_struct *p)
 				struct mem_cgroup, css);
 }
 
+/*
+ * Account a major fault by @mm to its memory cgroup. @swap tells that the
+ * faulted page had been swapped out, i.e. reclaimed from the group.
+ */
+void mem_cgroup_count_major_fault(struct mm_struct *mm, bool swap)
+{
+	struct mem_cgroup *mem;
+
+	if (!mm || mem_cgroup_disabled())
+		return;
+
+	rcu_read_lock();
+	mem = mem_cgroup_from_task(rcu_dereference(mm->owner));
+	if (likely(mem)) {
+		this_cpu_inc(mem->stat->count[MEM_CGROUP_STAT_PGMAJFAULT]);
+		if (swap)
+			this_cpu_inc(mem->stat->count[
+					MEM_CGROUP_STAT_SWAP_REFAULT]);
+	}
+	rcu_read_unlock();
+}
+
 static struct mem_cgroup *try_get_mem_cgroup_from_mm(struct mm_struct *mm)
 {
 	struct mem_cgroup *mem = NULL;
@@ -1260,11 +1341,13 @@ static int mem_cgroup_hierarchical_reclaim(struct mem_cgroup *root_mem,
 			continue;
 		}
 		/* we use swappiness of local cgroup */
-		if (check_soft)
+		if (check_soft) {
 			ret = mem_cgroup_shrink_node_zone(victim, gfp_mask,
 				noswap, get_swappiness(victim), zone,
 				zone->zone_pgdat->node_id);
-		else
+			this_cpu_add(victim->stat->count[
+					MEM_CGROUP_STAT_SOFT_RECLAIMED], ret);
+		} else
 			ret = try_to_free_mem_cgroup_pages(victim, gfp_mask,
 						noswap, get_swappiness(victim));
 		css_put(&victim->css);
@@ -3286,6 +3369,9 @@ enum {
 	MCS_PGPGIN,
 	MCS_PGPGOUT,
 	MCS_SWAP,
+	MCS_SOFT_RECLAIMED,
+	MCS_PGMAJFAULT,
+	MCS_SWAP_REFAULT,
 	MCS_INACTIVE_ANON,
 	MCS_ACTIVE_ANON,
 	MCS_INACTIVE_FILE,
@@ -3308,6 +3394,9 @@ struct {
 	{"pgpgin", "total_pgpgin"},
 	{"pgpgout", "total_pgpgout"},
 	{"swap", "total_swap"},
+	{"soft_reclaimed", "total_soft_reclaimed"},
+	{"pgmajfault", "total_pgmajfault"},
+	{"swap_refault", "total_swap_refault"},
 	{"inactive_anon", "total_inactive_anon"},
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
@@ -3336,6 +3425,12 @@ static int mem_cgroup_get_local_stat(struct mem_cgroup *mem, void *data)
 		val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_SWAPOUT);
 		s->stat[MCS_SWAP] += val * PAGE_SIZE;
 	}
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_SOFT_RECLAIMED);
+	s->stat[MCS_SOFT_RECLAIMED] += val;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_PGMAJFAULT);
+	s->stat[MCS_PGMAJFAULT] += val;
+	val = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_SWAP_REFAULT);
+	s->stat[MCS_SWAP_REFAULT] += val;
 
 	/* per zone stat */
 	val = mem_cgroup_get_local_zonestat(mem, LRU_INACTIVE_ANON);
@@ -3429,6 +3524,27 @@ static u64 mem_cgroup_swappiness_read(struct cgroup *cgrp, struct cftype *cft)
 	return get_swappiness(memcg);
 }
 
+static u64 mem_cgroup_soft_reclaim_priority_read(struct cgroup *cgrp,
+						 struct cftype *cft)
+{
+	return mem_cgroup_from_cont(cgrp)->soft_reclaim_priority;
+}
+
+static int mem_cgroup_soft_reclaim_priority_write(struct cgroup *cgrp,
+						  struct cftype *cft, u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+
+	if (val > MEM_CGROUP_SOFT_RECLAIM_PRIORITY_MAX)
+		return -EINVAL;
+
+	cgroup_lock();
+	mem_cgroup_set_soft_reclaim_priority(memcg, val);
+	cgroup_unlock();
+
+	return 0;
+}
+
 static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 				       u64 val)
 {
@@ -3837,6 +3953,11 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_swappiness_read,
 		.write_u64 = mem_cgroup_swappiness_write,
 	},
+	{
+		.name = "soft_reclaim_priority",
+		.read_u64 = mem_cgroup_soft_reclaim_priority_read,
+		.write_u64 = mem_cgroup_soft_reclaim_priority_write,
+	},
 	{
 		.name = "move_charge_at_immigrate",
 		.read_u64 = mem_cgroup_move_charge_read,
@@ -631,6 +631,48 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Return order 1..PCP_HIGH_ORDER blocks cached on @pcp to the buddy
+ * allocator, largest first since those help the buddy lists most, until
+ * at most @target base pages remain cached.
+ */
+static void free_pcppages_high_bulk(struct zone *zone, int target,
+					struct per_cpu_pages *pcp)
+{
+	int order, migratetype;
+	int freed = 0;
+
+	if (pcp->high_count <= target)
+		return;
+
+	spin_lock(&zone->lock);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	for (order = PCP_HIGH_ORDER; order > 0; order--) {
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+							migratetype++) {
+			struct list_head *list;
+			struct page *page;
+
+			list = &pcp->high_lists[order - 1][migratetype];
+			while (!list_empty(list) && pcp->high_count > target) {
+				page = list_entry(list->prev, struct page, lru);
+				list_del(&page->lru);
+				__free_one_page(page, zone, order,
+						page_private(page));
+				trace_mm_page_pcpu_drain(page, order,
+						page_private(page));
+				pcp->high_count -= 1 << order;
+				freed += 1 << order;
+			}
+		}
+	}
+	__mod_zone_page_state(zone, NR_FREE_PAGES, freed);
+	spin_unlock(&zone->lock);
+	__count_vm_events(PCP_HIGH_DRAIN, freed);
+}
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -672,10 +714,37 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 	return true;
 }
 
+/*
+ * Free a block of order 1..PCP_HIGH_ORDER to this cpu's high-order lists.
+ * Must be called with interrupts disabled.
+ */
+static void free_pcp_high_order(struct zone *zone, struct page *page,
+				int order, int migratetype)
+{
+	struct per_cpu_pages *pcp;
+
+	/* The pcp lists only hold plain blocks, as handed out by rmqueue */
+	if (unlikely(PageCompound(page)))
+		if (unlikely(destroy_compound_page(page, order)))
+			return;
+
+	set_page_private(page, migratetype);
+	/* As for order-0 pages, RESERVE blocks go on the MOVABLE list */
+	if (migratetype >= MIGRATE_PCPTYPES)
+		migratetype = MIGRATE_MOVABLE;
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list_add(&page->lru, &pcp->high_lists[order - 1][migratetype]);
+	pcp->high_count += 1 << order;
+	if (pcp->high_count >= 2 * pcp->batch)
+		free_pcppages_high_bulk(zone, pcp->batch, pcp);
+}
+
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
 	int wasMlocked = __TestClearPageMlocked(page);
+	int migratetype;
 
 	if (!free_pages_prepare(page, order))
 		return;
@@ -684,8 +753,11 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
-					get_pageblock_migratetype(page));
+	migratetype = get_pageblock_migratetype(page);
+	if (order <= PCP_HIGH_ORDER && migratetype != MIGRATE_ISOLATE)
+		free_pcp_high_order(page_zone(page), page, order, migratetype);
+	else
+		free_one_page(page_zone(page), page, order, migratetype);
 	local_irq_restore(flags);
 }
 
@@ -1071,6 +1143,7 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 		to_drain = pcp->count;
 	free_pcppages_bulk(zone, to_drain, pcp);
 	pcp->count -= to_drain;
+	free_pcppages_high_bulk(zone, 0, pcp);
 	local_irq_restore(flags);
 }
 #endif
@@ -1097,6 +1170,7 @@ static void drain_pages(unsigned int cpu)
 		pcp = &pset->pcp;
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		pcp->count = 0;
+		free_pcppages_high_bulk(zone, 0, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1278,6 +1352,44 @@ int split_free_page(struct page *page)
 	return 1 << order;
 }
 
+/*
+ * Take a block of order 1..PCP_HIGH_ORDER from this cpu's high-order lists,
+ * refilling them from the buddy allocator in one go when empty.
+ * Must be called with interrupts disabled.
+ */
+static struct page *rmqueue_pcp_high(struct zone *zone, int order,
+					int migratetype, int cold)
+{
+	struct per_cpu_pages *pcp;
+	struct list_head *list;
+	struct page *page;
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list = &pcp->high_lists[order - 1][migratetype];
+	if (list_empty(list)) {
+		int count;
+
+		/* Refill with about half a batch worth of base pages */
+		count = rmqueue_bulk(zone, order,
+				max(pcp->batch >> (order + 1), 1), list,
+				migratetype, cold);
+		if (unlikely(!count))
+			return NULL;
+		pcp->high_count += count << order;
+		__count_vm_event(PCP_HIGH_REFILL);
+	} else
+		__count_vm_event(PCP_HIGH_HIT);
+
+	if (cold)
+		page = list_entry(list->prev, struct page, lru);
+	else
+		page = list_entry(list->next, struct page, lru);
+
+	list_del(&page->lru);
+	pcp->high_count -= 1 << order;
+	return page;
+}
+
 /*
  * Really, prep_compound_page() should be called from __rmqueue_bulk().  But
  * we cheat by calling it from here, in the order > 0 path.  Saves a branch
@@ -1329,12 +1441,20 @@ again:
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
-		page = __rmqueue(zone, order, migratetype);
-		spin_unlock(&zone->lock);
-		if (!page)
-			goto failed;
-		__mod_zone_page_state(zone, NR_FREE_PAGES, -(1 << order));
+		if (order <= PCP_HIGH_ORDER) {
+			local_irq_save(flags);
+			page = rmqueue_pcp_high(zone, order, migratetype, cold);
+			if (!page)
+				goto failed;
+		} else {
+			spin_lock_irqsave(&zone->lock, flags);
+			page = __rmqueue(zone, order, migratetype);
+			spin_unlock(&zone->lock);
+			if (!page)
+				goto failed;
+			__mod_zone_page_state(zone, NR_FREE_PAGES,
+					      -(1 << order));
+		}
 	}
 
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
@@ -3366,7 +3486,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
-	int migratetype;
+	int migratetype, order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3374,8 +3494,11 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->count = 0;
 	pcp->high = 6 * batch;
 	pcp->batch = max(1UL, 1 * batch);
-	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
+	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++) {
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+		for (order = 0; order < PCP_HIGH_ORDER; order++)
+			INIT_LIST_HEAD(&pcp->high_lists[order][migratetype]);
+	}
 }
 
 /*
@@ -3483,6 +3606,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		free_pcppages_high_bulk(zone, 0, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -246,6 +246,10 @@ struct array_cache {
 	unsigned int limit;
 	unsigned int batchcount;
 	unsigned int touched;
+	/* fast path counters, only kept for the per-cpu arrays */
+	unsigned int allochit;
+	unsigned int refill;
+	unsigned int flush;
 	spinlock_t lock;
 	void *entry[];	/*
 			 * Must have this definition in here for the proper
@@ -366,6 +370,19 @@ static void kmem_list3_init(struct kmem_list3 *parent)
 #define REAPTIMEOUT_CPUC	(2*HZ)
 #define REAPTIMEOUT_LIST3	(4*HZ)
 
+/*
+ * cache_reap() resizes the per-cpu arrays of a cache at most every
+ * ADAPT_INTERVAL: the limit doubles (up to ADAPT_MAX_SCALE times the
+ * default) when a cpu refilled or flushed its array more than ADAPT_HOT
+ * times in the interval, and halves back towards the default when the
+ * cache saw no allocations at all.  The batchcount stays at its default,
+ * so that refills and flushes, which run with interrupts off, don't get
+ * longer as the arrays grow.
+ */
+#define ADAPT_INTERVAL		(8*HZ)
+#define ADAPT_HOT		32
+#define ADAPT_MAX_SCALE		4
+
 #if STATS
 #define	STATS_INC_ACTIVE(x)	((x)->num_active++)
 #define	STATS_DEC_ACTIVE(x)	((x)->num_active--)
@@ -887,6 +904,9 @@ static struct array_cache *alloc_arraycache(int node, int entries,
 		nc->limit = entries;
 		nc->batchcount = batchcount;
 		nc->touched = 0;
+		nc->allochit = 0;
+		nc->refill = 0;
+		nc->flush = 0;
 		spin_lock_init(&nc->lock);
 	}
 	return nc;
@@ -1140,6 +1160,11 @@ static void __cpuinit cpuup_canceled(long cpu)
 		/* cpu is dead; no one can alloc from it. */
 		nc = cachep->array[cpu];
 		cachep->array[cpu] = NULL;
+		if (nc) {
+			cachep->cpu_allochit += nc->allochit;
+			cachep->cpu_refill += nc->refill;
+			cachep->cpu_flush += nc->flush;
+		}
 		l3 = cachep->nodelists[node];
 
 		if (!l3)
@@ -3182,10 +3207,12 @@ static inline void *____cache_alloc(struct kmem_cache *cachep, gfp_t flags)
 	ac = cpu_cache_get(cachep);
 	if (likely(ac->avail)) {
 		STATS_INC_ALLOCHIT(cachep);
+		ac->allochit++;
 		ac->touched = 1;
 		objp = ac->entry[--ac->avail];
 	} else {
 		STATS_INC_ALLOCMISS(cachep);
+		ac->refill++;
 		objp = cache_alloc_refill(cachep, flags);
 		/*
 		 * the 'ac' may be updated by cache_alloc_refill(),
@@ -3559,6 +3586,7 @@ static void cache_flusharray(struct kmem_cache *cachep, struct array_cache *ac)
 	BUG_ON(!batchcount || batchcount > ac->avail);
 #endif
 	check_irq_off();
+	ac->flush++;
 	l3 = cachep->nodelists[node];
 	spin_lock(&l3->list_lock);
 	if (l3->shared) {
@@ -4008,6 +4036,9 @@ static int do_tune_cpucache(struct kmem_cache *cachep, int limit,
 		struct array_cache *ccold = new->new[i];
 		if (!ccold)
 			continue;
+		cachep->cpu_allochit += ccold->allochit;
+		cachep->cpu_refill += ccold->refill;
+		cachep->cpu_flush += ccold->flush;
 		spin_lock_irq(&cachep->nodelists[cpu_to_mem(i)]->list_lock);
 		free_block(cachep, ccold->entry, ccold->avail, cpu_to_mem(i));
 		spin_unlock_irq(&cachep->nodelists[cpu_to_mem(i)]->list_lock);
@@ -4017,11 +4048,9 @@ static int do_tune_cpucache(struct kmem_cache *cachep, int limit,
 	return alloc_kmemlist(cachep, gfp);
 }
 
-/* Called with cache_chain_mutex held always */
-static int enable_cpucache(struct kmem_cache *cachep, gfp_t gfp)
+static int cpucache_default_limit(struct kmem_cache *cachep)
 {
-	int err;
-	int limit, shared;
+	int limit;
 
 	/*
 	 * The head array serves three purposes:
@@ -4029,8 +4058,8 @@ static int enable_cpucache(struct kmem_cache *cachep, gfp_t gfp)
 	 * - reduce the number of spinlock operations.
 	 * - reduce the number of linked list operations on the slab and
 	 *   bufctl chains: array operations are cheaper.
-	 * The numbers are guessed, we should auto-tune as described by
-	 * Bonwick.
+	 * The numbers are guessed; cache_reap() then grows the arrays of
+	 * busy caches, roughly as described by Bonwick.
 	 */
 	if (cachep->buffer_size > 131072)
 		limit = 1;
@@ -4043,6 +4072,25 @@ static int enable_cpucache(struct kmem_cache *cachep, gfp_t gfp)
 	else
 		limit = 120;
 
+#if DEBUG
+	/*
+	 * With debugging enabled, large batchcount lead to excessively long
+	 * periods with disabled local interrupts. Limit the batchcount
+	 */
+	if (limit > 32)
+		limit = 32;
+#endif
+	return limit;
+}
+
+/* Called with cache_chain_mutex held always */
+static int enable_cpucache(struct kmem_cache *cachep, gfp_t gfp)
+{
+	int err;
+	int limit, shared;
+
+	limit = cpucache_default_limit(cachep);
+
 	/*
 	 * CPU bound tasks (e.g. network routing) can exhibit cpu bound
 	 * allocation behaviour: Most allocs on one cpu, most free operations
@@ -4056,14 +4104,7 @@ static int enable_cpucache(struct kmem_cache *cachep, gfp_t gfp)
 	if (cachep->buffer_size <= PAGE_SIZE && num_possible_cpus() > 1)
 		shared = 8;
 
-#if DEBUG
-	/*
-	 * With debugging enabled, large batchcount lead to excessively long
-	 * periods with disabled local interrupts. Limit the batchcount
-	 */
-	if (limit > 32)
-		limit = 32;
-#endif
+	cachep->next_adapt = jiffies + ADAPT_INTERVAL;
 	err = do_tune_cpucache(cachep, limit, (limit + 1) / 2, shared, gfp);
 	if (err)
 		printk(KERN_ERR "enable_cpucache failed for %s, error %d.\n",
@@ -4100,6 +4141,67 @@ void drain_array(struct kmem_cache *cachep, struct kmem_list3 *l3,
 	}
 }
 
+/*
+ * Sum the fast path counters of all per-cpu arrays of @cachep. The
+ * arrays of other cpus are read without locking, which is fine for
+ * statistics. Called with cache_chain_mutex held.
+ */
+static void cpucache_stats(struct kmem_cache *cachep, unsigned long *allochit,
+			   unsigned long *refill, unsigned long *flush)
+{
+	int cpu;
+
+	*allochit = cachep->cpu_allochit;
+	*refill = cachep->cpu_refill;
+	*flush = cachep->cpu_flush;
+	for_each_online_cpu(cpu) {
+		struct array_cache *ac = cachep->array[cpu];
+
+		if (!ac)
+			continue;
+		*allochit += ac->allochit;
+		*refill += ac->refill;
+		*flush += ac->flush;
+	}
+}
+
+/*
+ * Grow the per-cpu arrays of caches that keep falling out of the lock-free
+ * fast path, and shrink them back once the cache goes idle. Called from
+ * cache_reap() with cache_chain_mutex held.
+ */
+static void cpucache_adapt(struct kmem_cache *cachep)
+{
+	unsigned long allochit, refill, flush, churn, hits;
+	int limit, min_limit, max_limit;
+
+	if (cachep->user_tuned || time_before(jiffies, cachep->next_adapt))
+		return;
+	cachep->next_adapt = jiffies + ADAPT_INTERVAL;
+
+	cpucache_stats(cachep, &allochit, &refill, &flush);
+	churn = refill + flush - cachep->adapt_churn;
+	hits = allochit - cachep->adapt_allochit;
+	cachep->adapt_churn = refill + flush;
+	cachep->adapt_allochit = allochit;
+
+	min_limit = cpucache_default_limit(cachep);
+	max_limit = ADAPT_MAX_SCALE * min_limit;
+#if DEBUG
+	if (max_limit > 32)
+		max_limit = 32;
+#endif
+	limit = cachep->limit;
+	if (churn > ADAPT_HOT * num_online_cpus())
+		limit = min(2 * limit, max_limit);
+	else if (!churn && !hits)
+		limit = max(limit / 2, min_limit);
+
+	if (limit != cachep->limit)
+		do_tune_cpucache(cachep, limit, (min_limit + 1) / 2,
+				 cachep->shared, GFP_KERNEL);
+}
+
 /**
  * cache_reap - Reclaim memory from caches.
  * @w: work descriptor
@@ -4107,6 +4209,7 @@ void drain_array(struct kmem_cache *cachep, struct kmem_list3 *l3,
  * Called from workqueue/eventd every few seconds.
  * Purpose:
  * - clear the per-cpu caches for this CPU.
+ * - resize the per-cpu caches to the allocation rate of each cache.
  * - return freeable pages to the main free memory pool.
  *
  * If we cannot acquire the cache chain mutex then just give up - we'll try
@@ -4137,6 +4240,8 @@ static void cache_reap(struct work_struct *w)
 
 		drain_array(searchp, l3, cpu_cache_get(searchp), 0, node);
 
+		cpucache_adapt(searchp);
+
 		/*
 		 * These are racy checks but it does not matter
 		 * if we skip one check or scan twice.
@@ -4174,12 +4279,13 @@ static void print_slabinfo_header(struct seq_file *m)
 {
 	/*
 	 * Output format version, so at least we can change it
-	 * without _too_ many complaints.
+	 * without _too_ many complaints.  2.2 appends the cpucache
+	 * fields at the end of each line.
 	 */
 #if STATS
-	seq_puts(m, "slabinfo - version: 2.1 (statistics)\n");
+	seq_puts(m, "slabinfo - version: 2.2 (statistics)\n");
 #else
-	seq_puts(m, "slabinfo - version: 2.1\n");
+	seq_puts(m, "slabinfo - version: 2.2\n");
 #endif
 	seq_puts(m, "# name            <active_objs> <num_objs> <objsize> "
 		 "<objperslab> <pagesperslab>");
@@ -4190,6 +4296,7 @@ static void print_slabinfo_header(struct seq_file *m)
 		 "<error> <maxfreeable> <nodeallocs> <remotefrees> <alienoverflow>");
 	seq_puts(m, " : cpustat <allochit> <allocmiss> <freehit> <freemiss>");
 #endif
+	seq_puts(m, " : cpucache <allochit> <refill> <flush>");
 	seq_putc(m, '\n');
 }
 
@@ -4307,6 +4414,13 @@ static int s_show(struct seq_file *m, void *p)
 			   allochit, allocmiss, freehit, freemiss);
 	}
 #endif
+	{			/* cpucache fast path stats */
+		unsigned long allochit, refill, flush;
+
+		cpucache_stats(cachep, &allochit, &refill, &flush);
+		seq_printf(m, " : cpucache %8lu %6lu %6lu",
+			   allochit, refill, flush);
+	}
 	seq_putc(m, '\n');
 	return 0;
 }
@@ -4373,6 +4487,8 @@ ssize_t slabinfo_write(struct file *file, const char __user * buffer,
 				res = do_tune_cpucache(cachep, limit,
 						       batchcount, shared,
 						       GFP_KERNEL);
+				if (!res)
+					cachep->user_tuned = 1;
 			}
 			break;
 		}
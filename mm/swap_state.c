@@ -22,6 +22,34 @@
 
 #include <asm/pgtable.h>
 
+/*
+ * Readahead policy for anonymous swap-in faults: 0 reads ahead around the
+ * faulting swap slot, 1 reads ahead around the faulting virtual address.
+ */
+int swap_vma_readahead __read_mostly;
+
+/*
+ * VMA based readahead keeps its state in vma->swap_readahead_info: the
+ * page aligned address of the last fault, and in the bits below
+ * PAGE_SHIFT the last window size and the readahead hits since then.
+ */
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)				\
+	(((addr) & PAGE_MASK) |					\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+/* Never read ahead more than 1 << SWAP_RA_ORDER_CEILING ptes */
+#define SWAP_RA_ORDER_CEILING	5
+
 /*
  * swapper_space is a fiction, retained to simplify the path through
  * vmscan's shrink_page_list, to make sync_page look nicer, and to allow
@@ -133,6 +161,8 @@ void __delete_from_swap_cache(struct page *page)
 	radix_tree_delete(&swapper_space.page_tree, page_private(page));
 	set_page_private(page, 0);
 	ClearPageSwapCache(page);
+	if (TestClearPageReadahead(page))
+		__count_vm_event(SWAP_RA_MISS);
 	total_swapcache_pages--;
 	__dec_zone_page_state(page, NR_FILE_PAGES);
 	INC_CACHE_INFO(del_total);
@@ -256,15 +286,33 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
  * unlocked and with its refcount incremented - we rely on the kernel
  * lock getting page table operations atomic even if we drop the page
  * lock before returning.
+ *
+ * If the page was brought in by readahead, count the hit, and credit it
+ * to @vma's readahead window when one is given.
  */
-struct page * lookup_swap_cache(swp_entry_t entry)
+struct page * lookup_swap_cache(swp_entry_t entry,
+		struct vm_area_struct *vma, unsigned long addr)
 {
 	struct page *page;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			if (vma) {
+				unsigned long ra_val, hits;
+
+				ra_val = atomic_long_read(&vma->swap_readahead_info);
+				hits = min(SWAP_RA_HITS(ra_val) + 1,
+					   SWAP_RA_HITS_MAX);
+				atomic_long_set(&vma->swap_readahead_info,
+					SWAP_RA_VAL(addr, SWAP_RA_WIN(ra_val),
+						    hits));
+			}
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -275,13 +323,16 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * and reading the disk if it is not already cached.
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
+ * *@new_page_read is set when the read was started here.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry,
+			gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr, int *new_page_read)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new_page_read = 0;
 	do {
 		/*
 		 * First check the swap cache.  Since this is normally
@@ -332,6 +383,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			 */
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*new_page_read = 1;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -349,6 +401,38 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	int new_page_read;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &new_page_read);
+}
+
+/*
+ * Start readahead of @entry and mark the page so that a later swap cache
+ * lookup can tell readahead hits from misses. Returns 0 if the page could
+ * not be allocated, so the caller can stop reading ahead.
+ */
+static int swap_readahead_page(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	struct page *page;
+	int new_page_read;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &new_page_read);
+	if (!page)
+		return 0;
+	if (new_page_read) {
+		SetPageReadahead(page);
+		count_vm_event(SWAP_RA);
+	}
+	page_cache_release(page);
+	return 1;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -372,7 +456,6 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
 	int nr_pages;
-	struct page *page;
 	unsigned long offset;
 	unsigned long end_offset;
 
@@ -386,12 +469,132 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	nr_pages = valid_swaphandles(entry, &offset);
 	for (end_offset = offset + nr_pages; offset < end_offset; offset++) {
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
-		if (!page)
+		if (offset == swp_offset(entry))
+			continue;
+		if (!swap_readahead_page(swp_entry(swp_type(entry), offset),
+					 gfp_mask, vma, addr))
+			break;
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+	return read_swap_cache_async(entry, gfp_mask, vma, addr);
+}
+
+/*
+ * Size the readahead window from the hits since the last fault in this
+ * vma: grow it (in powers of two) while readahead pages keep being used,
+ * read nothing for random faults, and halve the old window otherwise.
+ */
+static unsigned int swapin_nr_pages(unsigned long prev_pfn, unsigned long pfn,
+			unsigned int hits, unsigned int max_pages,
+			unsigned int prev_win)
+{
+	unsigned int pages, last_ra;
+
+	pages = hits + 2;
+	if (pages == 2) {
+		/* No hits: only keep reading ahead for sequential faults */
+		if (pfn != prev_pfn + 1 && pfn != prev_pfn - 1)
+			pages = 1;
+	} else {
+		unsigned int roundup = 4;
+
+		while (roundup < pages)
+			roundup <<= 1;
+		pages = roundup;
+	}
+
+	if (pages > max_pages)
+		pages = max_pages;
+
+	last_ra = prev_win / 2;
+	if (pages < last_ra)
+		pages = last_ra;
+
+	return pages;
+}
+
+/**
+ * swapin_vma_readahead - swap in pages around the faulting address
+ * @entry: swap entry of this memory
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma this address belongs to
+ * @addr: target address for mempolicy
+ *
+ * Returns the struct page for entry and addr, after queueing swapin.
+ *
+ * Unlike swapin_readahead(), which reads the swap slots next to @entry
+ * whatever they belong to, read the swap entries found in the ptes next
+ * to @addr within @vma (and within the same page table), so that only
+ * pages of this mapping are brought in. The window adapts to how many
+ * of the pages read ahead at the previous fault were actually used.
+ *
+ * Caller must hold down_read on the vma->vm_mm, and must not hold the
+ * pte lock: the ptes are sampled without it, which is fine for a hint.
+ */
+struct page *swapin_vma_readahead(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	pte_t ptes[1 << SWAP_RA_ORDER_CEILING];
+	unsigned long ra_val, pfn, prev_pfn, start, end, lo, hi;
+	unsigned int max_win, win, left, i, nr;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte;
+
+	max_win = 1 << min(page_cluster, SWAP_RA_ORDER_CEILING);
+	if (max_win == 1)
+		goto skip;
+
+	pfn = addr >> PAGE_SHIFT;
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	prev_pfn = SWAP_RA_ADDR(ra_val) >> PAGE_SHIFT;
+	win = swapin_nr_pages(prev_pfn, pfn, SWAP_RA_HITS(ra_val), max_win,
+			      SWAP_RA_WIN(ra_val));
+	atomic_long_set(&vma->swap_readahead_info, SWAP_RA_VAL(addr, win, 0));
+	if (win == 1)
+		goto skip;
+
+	/* Read forward or backward following the fault direction */
+	if (pfn == prev_pfn + 1)
+		left = 0;
+	else if (pfn == prev_pfn - 1)
+		left = win - 1;
+	else
+		left = (win - 1) / 2;
+	start = pfn - min_t(unsigned long, left, pfn);
+	end = start + win;
+
+	/* Stay within the vma and the page table mapping @addr */
+	lo = max(vma->vm_start, addr & PMD_MASK) >> PAGE_SHIFT;
+	hi = (min(vma->vm_end - 1, (addr & PMD_MASK) + PMD_SIZE - 1) >>
+	      PAGE_SHIFT) + 1;
+	start = max(start, lo);
+	end = min(end, hi);
+	nr = end - start;
+
+	/* The fault path has just found a swap pte here, so the pmd exists */
+	pgd = pgd_offset(vma->vm_mm, addr);
+	pud = pud_offset(pgd, addr);
+	pmd = pmd_offset(pud, addr);
+	pte = pte_offset_map(pmd, start << PAGE_SHIFT);
+	for (i = 0; i < nr; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	for (i = 0; i < nr; i++) {
+		swp_entry_t ra_entry;
+
+		if (start + i == pfn || !is_swap_pte(ptes[i]))
+			continue;
+		ra_entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(ra_entry)))
+			continue;
+		if (!swap_readahead_page(ra_entry, gfp_mask, vma,
+					 (start + i) << PAGE_SHIFT))
 			break;
-		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
@@ -1748,6 +1748,18 @@ static void shrink_zones(int priority, struct zonelist *zonelist,
 
 			if (zone->all_unreclaimable && priority != DEF_PRIORITY)
 				continue;	/* Let kswapd poll it */
+
+			/*
+			 * Take pages from groups over their soft limit
+			 * (background apps) first, and leave everybody else
+			 * alone if that was enough.
+			 */
+			sc->nr_reclaimed += mem_cgroup_soft_limit_reclaim(zone,
+						sc->order, sc->gfp_mask,
+						zone_to_nid(zone),
+						zone_idx(zone));
+			if (sc->nr_reclaimed >= sc->nr_to_reclaim)
+				continue;
 		} else {
 			/*
 			 * Ignore cpuset limitation here. We just want to reduce
@@ -2130,6 +2142,7 @@ loop_again:
 		 */
 		for (i = 0; i <= end_zone; i++) {
 			struct zone *zone = pgdat->node_zones + i;
+			unsigned long nr_soft;
 			int nr_slab;
 			int nid, zid;
 
@@ -2146,16 +2159,20 @@ loop_again:
 			nid = pgdat->node_id;
 			zid = zone_idx(zone);
 			/*
-			 * Call soft limit reclaim before calling shrink_zone.
-			 * For now we ignore the return value
+			 * Call soft limit reclaim before calling shrink_zone,
+			 * and leave the zone's other pages alone if reclaiming
+			 * from groups over their soft limit was enough.
 			 */
-			mem_cgroup_soft_limit_reclaim(zone, order, sc.gfp_mask,
-							nid, zid);
+			nr_soft = mem_cgroup_soft_limit_reclaim(zone, order,
+						sc.gfp_mask, nid, zid);
+			sc.nr_reclaimed += nr_soft;
 			/*
 			 * We put equal pressure on every zone, unless one
 			 * zone has way too many pages free already.
 			 */
-			if (!zone_watermark_ok(zone, order,
+			if (!(nr_soft && zone_watermark_ok(zone, order,
+					high_wmark_pages(zone), end_zone, 0)) &&
+			    !zone_watermark_ok(zone, order,
 					8*high_wmark_pages(zone), end_zone, 0))
 				shrink_zone(priority, zone, &sc);
 			reclaim_state->reclaimed_slab = 0;
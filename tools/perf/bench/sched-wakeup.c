@@ -0,0 +1,215 @@
+/*
+ *
+ * sched-wakeup.c
+ *
+ * wakeup: Benchmark for the wakeup latency of a task competing with
+ *         cpu hogs, with and without PR_SET_LATENCY_BOOST
+ *
+ * A task sleeps for a fixed interval and measures how late it gets to
+ * run after its timer fired, while a number of busy-looping tasks share
+ * its cpu.  The measurement is made twice, the second time with the
+ * sleeping task boosted from the parent with
+ * prctl(PR_SET_LATENCY_BOOST, 1, pid).
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+
+#ifndef PR_SET_TIMERSLACK
+#define PR_SET_TIMERSLACK 29
+#endif
+#ifndef PR_SET_LATENCY_BOOST
+#define PR_SET_LATENCY_BOOST 0x4c420001
+#endif
+
+static int loops = 1000;
+static int sleep_usec = 2000;
+static int nr_hogs = 2;
+static int cpu;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of wakeups"),
+	OPT_INTEGER('s', "sleep", &sleep_usec,
+		    "Specify sleep interval in usecs"),
+	OPT_INTEGER('n', "hogs", &nr_hogs,
+		    "Specify number of busy-looping tasks"),
+	OPT_INTEGER('c', "cpu", &cpu,
+		    "Specify the cpu to run everything on"),
+	OPT_END()
+};
+
+static const char * const bench_sched_wakeup_usage[] = {
+	"perf bench sched wakeup <options>",
+	NULL
+};
+
+struct wakeup_result {
+	unsigned long long total_nsec;
+	unsigned long long max_nsec;
+};
+
+static void bind_to_cpu(void)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask))
+		die("sched_setaffinity");
+}
+
+static unsigned long long timespec_nsec(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static void __noreturn run_sleeper(int start_fd, int result_fd)
+{
+	struct wakeup_result res = { 0, 0 };
+	struct timespec when, now;
+	unsigned long long late;
+	char c;
+	int i;
+
+	/* wait until the parent has set up our boost */
+	if (read(start_fd, &c, 1) != 1)
+		exit(1);
+
+	for (i = 0; i < loops; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &when);
+		when.tv_nsec += sleep_usec * 1000L;
+		while (when.tv_nsec >= 1000000000L) {
+			when.tv_nsec -= 1000000000L;
+			when.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		late = timespec_nsec(&now) - timespec_nsec(&when);
+		res.total_nsec += late;
+		if (late > res.max_nsec)
+			res.max_nsec = late;
+	}
+
+	if (write(result_fd, &res, sizeof(res)) != sizeof(res))
+		exit(1);
+	exit(0);
+}
+
+static int measure(int boost, struct wakeup_result *res)
+{
+	int start_pipe[2], result_pipe[2];
+	int err = 0;
+	pid_t pid;
+
+	if (pipe(start_pipe) || pipe(result_pipe))
+		die("pipe");
+
+	pid = fork();
+	if (pid < 0)
+		die("fork");
+	if (!pid)
+		run_sleeper(start_pipe[0], result_pipe[1]);
+
+	if (boost && prctl(PR_SET_LATENCY_BOOST, 1, pid, 0, 0)) {
+		err = -1;
+		kill(pid, SIGKILL);
+	} else if (write(start_pipe[1], "", 1) != 1 ||
+		   read(result_pipe[0], res, sizeof(*res)) != sizeof(*res)) {
+		die("sleeper");
+	}
+	waitpid(pid, NULL, 0);
+
+	close(start_pipe[0]);
+	close(start_pipe[1]);
+	close(result_pipe[0]);
+	close(result_pipe[1]);
+	return err;
+}
+
+int bench_sched_wakeup(int argc, const char **argv,
+		       const char *prefix __used)
+{
+	struct wakeup_result plain, boosted;
+	pid_t *hogs;
+	int i, err;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_wakeup_usage, 0);
+	if (loops <= 0 || sleep_usec <= 0 || nr_hogs < 0)
+		usage_with_options(bench_sched_wakeup_usage, options);
+
+	bind_to_cpu();
+	/* don't let timer slack hide the scheduling delay */
+	prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+
+	hogs = calloc(nr_hogs, sizeof(pid_t));
+	if (!hogs)
+		die("calloc");
+	for (i = 0; i < nr_hogs; i++) {
+		hogs[i] = fork();
+		if (hogs[i] < 0)
+			die("fork");
+		if (!hogs[i])
+			for (;;)
+				;
+	}
+
+	measure(0, &plain);
+	err = measure(1, &boosted);
+
+	for (i = 0; i < nr_hogs; i++) {
+		kill(hogs[i], SIGKILL);
+		waitpid(hogs[i], NULL, 0);
+	}
+	free(hogs);
+
+	if (err) {
+		fprintf(stderr, "PR_SET_LATENCY_BOOST is not supported\n");
+		boosted = plain;
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d wakeups every %d usecs against %d cpu hogs"
+		       " on cpu %d\n\n", loops, sleep_usec, nr_hogs, cpu);
+		printf(" %14s: %10.1lf usecs avg %10.1lf usecs max\n",
+		       "Without boost",
+		       (double)plain.total_nsec / loops / 1000,
+		       (double)plain.max_nsec / 1000);
+		printf(" %14s: %10.1lf usecs avg %10.1lf usecs max\n",
+		       "With boost",
+		       (double)boosted.total_nsec / loops / 1000,
+		       (double)boosted.max_nsec / 1000);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.1lf %.1lf\n",
+		       (double)plain.total_nsec / loops / 1000,
+		       (double)boosted.total_nsec / loops / 1000);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
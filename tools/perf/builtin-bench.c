@@ -42,6 +42,9 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "wakeup",
+	  "Wakeup latency against cpu hogs, with and without latency boost",
+	  bench_sched_wakeup    },
 	suite_all,
 	{ NULL,
 	  NULL,